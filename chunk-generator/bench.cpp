@@ -0,0 +1,858 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "blockstorage.h"
+#include "chunk.h"
+#include "chunkpool.h"
+#include "client.h"
+#include "collision.h"
+#include "density.h"
+#include "journal.h"
+#include "light.h"
+#include "mesher.h"
+#include "noise.h"
+#include "server.h"
+#include "workers.h"
+#include "world.h"
+
+namespace Bench {
+	namespace {
+		using Clock = std::chrono::steady_clock;
+
+		constexpr uint32_t SEED = 0;
+		constexpr int BENCH_CHUNKS_SIDE = 8;
+
+		// the section the ground mostly runs through, where single layer benchmarks generate
+		constexpr int SURFACE_SECTION = HEIGHT_BASELINE / CHUNK_MAX_Y;
+
+		// as registered by testRegister
+		constexpr Block::BlockType GRASS = 1;
+		constexpr Block::BlockType LAMP = 2;
+
+		// set by a failed check, run then returns 1
+		bool failed = false;
+
+		double elapsedMicros(Clock::time_point start) {
+			return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		}
+
+		void check(bool passed, const std::string& what) {
+			std::cout << what << ": " << (passed ? "ok" : "FAILED") << "\n";
+			if (!passed) failed = true;
+		}
+
+		// generates a square of chunks and reports the average cost per chunk
+		template <typename MakeChunk>
+		void timeChunks(const char* label, MakeChunk makeChunk) {
+			std::vector<std::unique_ptr<Chunk>> chunks;
+			chunks.reserve(BENCH_CHUNKS_SIDE * BENCH_CHUNKS_SIDE);
+
+			auto start = Clock::now();
+			for (int x = 0; x < BENCH_CHUNKS_SIDE; x++) {
+				for (int z = 0; z < BENCH_CHUNKS_SIDE; z++) {
+					chunks.push_back(makeChunk(x, z));
+				}
+			}
+			double micros = elapsedMicros(start);
+
+			std::cout << label << ": " << micros / chunks.size() << "us per chunk\n";
+		}
+
+		// memory and meshing of heightmap chunks against the same chunks with their blocks filled in
+		void heightmapMeshing() {
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			std::vector<std::unique_ptr<Chunk>> chunks;
+			std::vector<Chunk::Snapshot> lazy, dense;
+			size_t lazyBytes = 0;
+			for (int x = 0; x < BENCH_CHUNKS_SIDE; x++) {
+				for (int z = 0; z < BENCH_CHUNKS_SIDE; z++) {
+					chunks.push_back(std::make_unique<Chunk>(SEED, x, SURFACE_SECTION, z, noise));
+					lazyBytes += chunks.back()->residentBytes();
+					lazy.push_back(chunks.back()->snapshot());
+
+					auto blocks = std::make_shared<ChunkBlocks>();
+					blocks->decompress(chunks.back()->compressBlocks());
+					dense.push_back({ blocks, nullptr, lazy.back().heights, 0 });
+				}
+			}
+			size_t denseBytes = lazyBytes + chunks.size() * (dense[0].blocks->byteSize() + CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z);
+			std::cout << "heightmap chunks hold " << lazyBytes / chunks.size() << " bytes, "
+				<< denseBytes / chunks.size() << " with blocks and light\n";
+
+			for (const auto& [label, snapshots] : { std::make_pair("from heights", &lazy), std::make_pair("from blocks", &dense) }) {
+				auto start = Clock::now();
+				for (const Chunk::Snapshot& snapshot : *snapshots) ChunkPool::getInstance().giveMesh(Chunk::meshSnapshot(snapshot, {}, nullptr));
+				std::cout << "mesh " << label << ": " << elapsedMicros(start) / snapshots->size() << "us per chunk\n";
+			}
+
+			// the column walk must find the same faces forEachVisibleFace finds in the filled in blocks, in any order
+			auto key = [](const Vertex& v) {
+				return std::make_tuple(v.coords.x, v.coords.y, v.coords.z, v.normal.x, v.normal.y, v.normal.z,
+					v.texCoords.x, v.texCoords.y, v.blockType, v.face, v.light);
+			};
+			auto sorted = [&key](std::vector<Vertex> vertices) {
+				std::sort(vertices.begin(), vertices.end(), [&key](const Vertex& a, const Vertex& b) { return key(a) < key(b); });
+				return vertices;
+			};
+			int mismatches = 0;
+			for (size_t i = 0; i < chunks.size(); i++) {
+				std::vector<Vertex> fromHeights = sorted(Chunk::meshSnapshot(lazy[i], {}, nullptr));
+				std::vector<Vertex> fromBlocks = sorted(Chunk::meshSnapshot(dense[i], {}, nullptr));
+				bool same = fromHeights.size() == fromBlocks.size() && std::equal(fromHeights.begin(), fromHeights.end(), fromBlocks.begin(),
+					[&key](const Vertex& a, const Vertex& b) { return key(a) == key(b); });
+				if (!same) mismatches++;
+			}
+			check(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(chunks.size()) + " meshes from heights differ from the blocks'");
+		}
+
+		// every section of a few whole columns meshed against its six neighbours, from the heights and from the filled in blocks,
+		// so faces between sections stacked in a column are covered as well as those inside the surface section
+		void sectionMeshing() {
+			constexpr int SIDE = 4;
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			std::unordered_map<ivec3, Chunk::Snapshot, vec3Hash> lazy, dense;
+			std::vector<std::unique_ptr<Chunk>> chunks;
+			for (int x = 0; x < SIDE; x++) {
+				for (int y = 0; y < WORLD_CHUNKS_Y; y++) {
+					for (int z = 0; z < SIDE; z++) {
+						chunks.push_back(std::make_unique<Chunk>(SEED, x, y, z, noise));
+						Chunk::Snapshot snapshot = chunks.back()->snapshot();
+						auto blocks = std::make_shared<ChunkBlocks>();
+						blocks->decompress(chunks.back()->compressBlocks());
+						lazy[ivec3(x, y, z)] = snapshot;
+						dense[ivec3(x, y, z)] = { blocks, nullptr, snapshot.heights, 0 };
+					}
+				}
+			}
+
+			auto key = [](const Vertex& v) {
+				return std::make_tuple(v.coords.x, v.coords.y, v.coords.z, v.normal.x, v.normal.y, v.normal.z,
+					v.texCoords.x, v.texCoords.y, v.blockType, v.face, v.light);
+			};
+			auto mesh = [&key](const std::unordered_map<ivec3, Chunk::Snapshot, vec3Hash>& snapshots, ivec3 coords) {
+				Chunk::NeighbourSnapshots neighbours;
+				for (int face = 0; face < 6; face++) {
+					auto found = snapshots.find(coords + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]));
+					if (found != snapshots.end()) neighbours[face] = found->second;
+				}
+				std::vector<Vertex> vertices = Chunk::meshSnapshot(snapshots.at(coords), neighbours, nullptr);
+				std::sort(vertices.begin(), vertices.end(), [&key](const Vertex& a, const Vertex& b) { return key(a) < key(b); });
+				return vertices;
+			};
+
+			int meshed = 0, mismatches = 0;
+			for (int x = 1; x < SIDE - 1; x++) {
+				for (int y = 0; y < WORLD_CHUNKS_Y; y++) {
+					for (int z = 1; z < SIDE - 1; z++) {
+						std::vector<Vertex> fromHeights = mesh(lazy, ivec3(x, y, z));
+						std::vector<Vertex> fromBlocks = mesh(dense, ivec3(x, y, z));
+						bool same = fromHeights.size() == fromBlocks.size() && std::equal(fromHeights.begin(), fromHeights.end(), fromBlocks.begin(),
+							[&key](const Vertex& a, const Vertex& b) { return key(a) == key(b); });
+						if (!same) mismatches++;
+						meshed++;
+					}
+				}
+			}
+			check(mismatches == 0, std::to_string(mismatches) + " of " + std::to_string(meshed) + " sections meshed with their neighbours differ from their blocks'");
+		}
+
+		void terrain() {
+			timeChunks("heightmap", [noise = Noise::TileCache(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES)](int x, int z) mutable {
+				return std::make_unique<Chunk>(SEED, x, SURFACE_SECTION, z, noise);
+			});
+			heightmapMeshing();
+			sectionMeshing();
+
+			auto compileStart = Clock::now();
+			Density::Plan plan = World::buildDensityTerrain(SEED);
+			std::cout << "density graph compiled to " << plan.instructionCount() << " instructions in " << elapsedMicros(compileStart) << "us\n";
+
+			timeChunks("density, coarse cells", [&plan](int x, int z) {
+				return std::make_unique<Chunk>(SEED, x, SURFACE_SECTION, z, plan);
+			});
+
+			// what sampling every block of the same chunks would cost, for comparison with the coarse cells
+			std::vector<float> samples;
+			auto start = Clock::now();
+			for (int x = 0; x < BENCH_CHUNKS_SIDE; x++) {
+				for (int z = 0; z < BENCH_CHUNKS_SIDE; z++) {
+					plan.evaluateGrid(ivec3(x * CHUNK_MAX_X, SURFACE_SECTION * CHUNK_MAX_Y, z * CHUNK_MAX_Z), ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z),
+						ivec3(1), samples);
+				}
+			}
+			std::cout << "density, every block: " << elapsedMicros(start) / (BENCH_CHUNKS_SIDE * BENCH_CHUNKS_SIDE) << "us per chunk\n";
+		}
+
+		// fill, mesh and raycast over one layout, using the same heights for every layout
+		template <template <int, int, int> class LayoutPolicy>
+		void timeLayout(const char* label, const std::vector<std::vector<int>>& heights) {
+			using Storage = BlockStorage<CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z, LayoutPolicy>;
+			std::vector<Storage> chunks(heights.size());
+
+			auto start = Clock::now();
+			for (size_t i = 0; i < chunks.size(); i++) {
+				for (int z = 0; z < CHUNK_MAX_Z; z++) {
+					for (int x = 0; x < CHUNK_MAX_X; x++) {
+						int height = std::clamp(HEIGHT_BASELINE - SURFACE_SECTION * CHUNK_MAX_Y + heights[i][x + CHUNK_MAX_X * z], 0, CHUNK_MAX_Y);
+						chunks[i].fillColumn(x, z, 0, height, 1);
+					}
+				}
+			}
+			double fillMicros = elapsedMicros(start) / chunks.size();
+
+			Mesher::TagTable tags;
+			std::vector<Vertex> vertices;
+			vertices.reserve(CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z * 6);
+			start = Clock::now();
+			for (const Storage& chunk : chunks) {
+				vertices.clear();
+				Mesher::forEachVisibleFace(chunk, tags, [&vertices, &chunk](int x, int y, int z, int face) {
+					for (int i = 0; i < 6; i++) {
+						Vertex vertex = Block::cubeVertices[face * 6 + i];
+						vertex.coords += ivec3(x, y, z);
+						vertex.blockType = chunk.get(x, y, z);
+						vertex.face = face;
+						vertices.push_back(vertex);
+					}
+				});
+			}
+			double meshMicros = elapsedMicros(start) / chunks.size();
+
+			// straight down rays from random columns, the access pattern of block selection and collision
+			constexpr int RAYS = 100000;
+			std::mt19937 rng(SEED);
+			std::uniform_int_distribution<int> column(0, CHUNK_MAX_X - 1);
+			std::uniform_int_distribution<size_t> pick(0, chunks.size() - 1);
+			long long hits = 0;
+			start = Clock::now();
+			for (int ray = 0; ray < RAYS; ray++) {
+				const Storage& chunk = chunks[pick(rng)];
+				int x = column(rng), z = column(rng);
+				int dx = ray % 3 - 1, dz = (ray / 3) % 3 - 1;
+				for (int y = CHUNK_MAX_Y - 1; y >= 0; y--) {
+					if (chunk.get(x, y, z) != 0) {
+						hits++;
+						break;
+					}
+					// drift sideways so rays don't only walk single columns
+					x = (x + dx + CHUNK_MAX_X) % CHUNK_MAX_X;
+					z = (z + dz + CHUNK_MAX_Z) % CHUNK_MAX_Z;
+				}
+			}
+			double rayNanos = elapsedMicros(start) * 1000.0 / RAYS;
+
+			std::cout << label << ": fill " << fillMicros << "us, mesh " << meshMicros << "us per chunk, "
+				<< "raycast " << rayNanos << "ns per ray (" << hits << " hits), "
+				<< chunks[0].byteSize() << " bytes per chunk\n";
+		}
+
+		void layouts() {
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			std::vector<std::vector<int>> heights(BENCH_CHUNKS_SIDE * BENCH_CHUNKS_SIDE);
+			for (size_t i = 0; i < heights.size(); i++) {
+				noise.slice(i % BENCH_CHUNKS_SIDE, i / BENCH_CHUNKS_SIDE, heights[i]);
+			}
+
+			timeLayout<Layout::XMajor>("x major", heights);
+			timeLayout<Layout::YMajor>("y major", heights);
+			timeLayout<Layout::Morton>("morton", heights);
+		}
+
+		// one kind of edit applied at many random columns and then undone, timing only the relighting
+		template <typename Edit>
+		void timeLightEdits(const char* label, ChunkMap& chunks, Light::Engine& engine, Edit edit) {
+			constexpr int EDITS = 2000;
+			std::mt19937 rng(SEED);
+			// edits stay a chunk away from the edge so their light has somewhere to go
+			std::uniform_int_distribution<int> column(CHUNK_MAX_X, (BENCH_CHUNKS_SIDE - 1) * CHUNK_MAX_X - 1);
+
+			// the columns are whole, every position inside the world has a chunk
+			auto locate = [&chunks](ivec3 position) -> std::pair<Chunk&, ivec3> {
+				ivec3 coords(Noise::floorDiv(position.x, CHUNK_MAX_X), position.y / CHUNK_MAX_Y, Noise::floorDiv(position.z, CHUNK_MAX_Z));
+				return { *chunks.at(coords), position - coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z) };
+			};
+			auto setBlock = [&locate, &engine](ivec3 position, Block::BlockType type) {
+				auto [chunk, local] = locate(position);
+				Block::BlockType oldType = chunk.getBlock(local);
+				if (type == 0) chunk.removeBlock(local);
+				else chunk.placeBlock(local, type);
+				engine.blockChanged(position, oldType);
+			};
+
+			const Light::Engine::Stats before = engine.getStats();
+			double micros = 0;
+			int edits = 0;
+			for (int i = 0; i < EDITS; i++) {
+				int x = column(rng), z = column(rng);
+				int y = WORLD_HEIGHT - 1;
+				for (; y > 0; y--) {
+					auto [chunk, local] = locate(ivec3(x, y, z));
+					if (chunk.getBlock(local) != 0) break;
+				}
+
+				// surface is the highest solid block, edits pick their target from it and return what to restore
+				auto [position, type] = edit(ivec3(x, y, z));
+				if (position.y < 0 || position.y >= WORLD_HEIGHT) continue;
+				auto [target, local] = locate(position);
+				Block::BlockType previous = target.getBlock(local);
+
+				auto start = Clock::now();
+				setBlock(position, type);
+				setBlock(position, previous);
+				micros += elapsedMicros(start);
+				edits += 2;
+			}
+			engine.takeDirty();
+
+			const Light::Engine::Stats& after = engine.getStats();
+			uint64_t cells = (after.cellsLit - before.cellsLit) + (after.cellsCleared - before.cellsCleared);
+			std::cout << label << ": " << edits / micros * 1e6 << " edits per second, "
+				<< micros / edits << "us and " << cells / static_cast<double>(edits) << " cells per edit\n";
+		}
+
+		// relights the square from scratch with one flood fill per channel and counts the cells the engine disagrees with
+		// the square is whole columns, sky comes in from above the world and nothing comes in from the sides
+		int64_t countLightMismatches(const ChunkMap& chunks) {
+			constexpr int SIDE = BENCH_CHUNKS_SIDE * CHUNK_MAX_X;
+			auto index = [](int x, int y, int z) { return (static_cast<size_t>(z) * SIDE + x) * WORLD_HEIGHT + y; };
+
+			const Mesher::TagTable tags;
+			const Block::BlockRegistry& registry = Block::BlockRegistry::getInstance();
+			std::vector<uint8_t> transparent(static_cast<size_t>(SIDE) * SIDE * WORLD_HEIGHT);
+			std::vector<uint8_t> expected[Light::CHANNEL_COUNT];
+			for (auto& levels : expected) levels.assign(transparent.size(), 0);
+			std::vector<ivec3> queue[Light::CHANNEL_COUNT];
+
+			for (const auto& [coords, chunk] : chunks) {
+				const ivec3 origin = coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+				for (int z = 0; z < CHUNK_MAX_Z; z++) {
+					for (int x = 0; x < CHUNK_MAX_X; x++) {
+						for (int y = 0; y < CHUNK_MAX_Y; y++) {
+							const Block::BlockType type = chunk->getBlock({ x, y, z });
+							const ivec3 position = origin + ivec3(x, y, z);
+							const size_t i = index(position.x, position.y, position.z);
+							transparent[i] = tags.transparent[type];
+
+							const int emission = std::min<int>(registry.getDef(type).lightEmission, Light::MAX_LEVEL);
+							if (emission > 0) {
+								expected[Light::BLOCK][i] = static_cast<uint8_t>(emission);
+								queue[Light::BLOCK].push_back(position);
+							}
+						}
+					}
+				}
+			}
+
+			// full sky falls straight down each column without fading
+			for (int z = 0; z < SIDE; z++) {
+				for (int x = 0; x < SIDE; x++) {
+					for (int y = WORLD_HEIGHT - 1; y >= 0 && transparent[index(x, y, z)]; y--) {
+						expected[Light::SKY][index(x, y, z)] = Light::MAX_LEVEL;
+						queue[Light::SKY].push_back(ivec3(x, y, z));
+					}
+				}
+			}
+
+			for (int channel = 0; channel < Light::CHANNEL_COUNT; channel++) {
+				std::vector<uint8_t>& levels = expected[channel];
+				for (size_t next = 0; next < queue[channel].size(); next++) {
+					const ivec3 position = queue[channel][next];
+					const int level = levels[index(position.x, position.y, position.z)];
+					for (int face = 0; face < 6; face++) {
+						const ivec3 to = position + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]);
+						if (to.x < 0 || to.x >= SIDE || to.z < 0 || to.z >= SIDE || to.y < 0 || to.y >= WORLD_HEIGHT) continue;
+						const size_t i = index(to.x, to.y, to.z);
+						if (!transparent[i] || levels[i] >= level - 1) continue;
+						levels[i] = static_cast<uint8_t>(level - 1);
+						queue[channel].push_back(to);
+					}
+				}
+			}
+
+			int64_t mismatches = 0;
+			for (const auto& [coords, chunk] : chunks) {
+				const ivec3 origin = coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+				for (int z = 0; z < CHUNK_MAX_Z; z++) {
+					for (int x = 0; x < CHUNK_MAX_X; x++) {
+						for (int y = 0; y < CHUNK_MAX_Y; y++) {
+							const ivec3 position = origin + ivec3(x, y, z);
+							const size_t i = index(position.x, position.y, position.z);
+							const uint8_t light = chunk->getLight({ x, y, z });
+							if (Light::getLevel(light, Light::SKY) != expected[Light::SKY][i]
+								|| Light::getLevel(light, Light::BLOCK) != expected[Light::BLOCK][i]) mismatches++;
+						}
+					}
+				}
+			}
+			return mismatches;
+		}
+
+		void lightWorld(const char* label, std::function<std::unique_ptr<Chunk>(int, int, int)> makeChunk) {
+			ChunkMap chunks;
+			Light::Engine engine(chunks);
+
+			// each chunk is lit as it loads like the world does, which is also what a full relight would cost
+			// whole columns from the top down, so sky light comes from the sections above like in the world
+			double micros = 0;
+			for (int x = 0; x < BENCH_CHUNKS_SIDE; x++) {
+				for (int z = 0; z < BENCH_CHUNKS_SIDE; z++) {
+					for (int y = WORLD_CHUNKS_Y - 1; y >= 0; y--) {
+						chunks.emplace(ivec3(x, y, z), makeChunk(x, y, z));
+
+						auto start = Clock::now();
+						engine.addChunk(ivec3(x, y, z));
+						micros += elapsedMicros(start);
+					}
+				}
+			}
+			std::cout << label << " terrain, full light per chunk: " << micros / chunks.size() << "us\n";
+			engine.takeDirty();
+
+			timeLightEdits("  dig the surface", chunks, engine, [](ivec3 surface) { return std::make_pair(surface, Block::BlockType(0)); });
+			timeLightEdits("  dig under the surface", chunks, engine, [](ivec3 surface) { return std::make_pair(surface - ivec3(0, 3, 0), Block::BlockType(0)); });
+			timeLightEdits("  build above the surface", chunks, engine, [](ivec3 surface) { return std::make_pair(surface + ivec3(0, 4, 0), GRASS); });
+			timeLightEdits("  place a lamp", chunks, engine, [](ivec3 surface) { return std::make_pair(surface + ivec3(0, 1, 0), LAMP); });
+
+			const int64_t mismatches = countLightMismatches(chunks);
+			check(mismatches == 0, std::string("  ") + std::to_string(mismatches) + " cells differ from a full relight");
+		}
+
+		void light() {
+			if (Block::BlockRegistry::getInstance().size() < 3) {
+				std::cout << "light needs a light emitting block registered as type 2\n";
+				return;
+			}
+
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			lightWorld("heightmap", [&noise](int x, int y, int z) { return std::make_unique<Chunk>(SEED, x, y, z, noise); });
+
+			Density::Plan plan = World::buildDensityTerrain(SEED);
+			lightWorld("density", [&plan](int x, int y, int z) { return std::make_unique<Chunk>(SEED, x, y, z, plan); });
+		}
+
+		// heights from NOISE_STRIDES against sampling every column, over a square of whole noise tiles
+		void noise() {
+			// each strided octave can be off by its interpolation error plus one from rounding
+			constexpr int MAX_ERROR_BOUND = 4;
+			constexpr double MEAN_ERROR_BOUND = 0.25;
+			constexpr int side = 4 * Noise::TileCache::TILE_CHUNKS;
+
+			Noise::TileCache full(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE);
+			Noise::TileCache strided(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+
+			std::vector<int> exact, approximate;
+			int maxError = 0;
+			long long totalError = 0, columns = 0;
+			for (int x = 0; x < side; x++) {
+				for (int z = 0; z < side; z++) {
+					full.slice(x, z, exact);
+					strided.slice(x, z, approximate);
+					for (size_t i = 0; i < exact.size(); i++) {
+						int error = std::abs(exact[i] - approximate[i]);
+						maxError = std::max(maxError, error);
+						totalError += error;
+						columns++;
+					}
+				}
+			}
+			double meanError = static_cast<double>(totalError) / columns;
+
+			constexpr int chunkCount = side * side;
+			std::cout << "every column: " << full.getStats().generateMicros / static_cast<double>(chunkCount) << "us per chunk\n";
+			std::cout << "strides";
+			for (int stride : NOISE_STRIDES) std::cout << " " << stride;
+			std::cout << ": " << strided.getStats().generateMicros / static_cast<double>(chunkCount) << "us per chunk\n";
+
+			std::ostringstream error;
+			error << "height error: max " << maxError << " (bound " << MAX_ERROR_BOUND << "), mean " << meanError
+				<< " (bound " << MEAN_ERROR_BOUND << ") blocks";
+			check(maxError <= MAX_ERROR_BOUND && meanError <= MEAN_ERROR_BOUND, error.str());
+		}
+
+		// many boxes falling and sliding over heightmap terrain, every box moved every tick
+		// random moves checked one block at a time: a box never ends up inside a block, goes the whole way unless it was
+		// blocked, and when blocked has a block right in front of it. A move is one axis at a time in sweep's order,
+		// which must land where moving along all three at once does
+		void checkCollision(const ChunkMap& chunks) {
+			constexpr int MOVES = 20000;
+			constexpr float TOUCH = 0.01f; // how far past a blocked box the block must be
+
+			const Mesher::TagTable tags;
+			auto solidAt = [&chunks, &tags](ivec3 cell) {
+				if (cell.y < 0) return true;
+				if (cell.y >= WORLD_HEIGHT) return false;
+				ivec3 coords(Noise::floorDiv(cell.x, CHUNK_MAX_X), cell.y / CHUNK_MAX_Y, Noise::floorDiv(cell.z, CHUNK_MAX_Z));
+				auto found = chunks.find(coords);
+				if (found == chunks.end() || found->second->isCold()) return true;
+				return !tags.air[found->second->getBlock(cell - coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z))];
+			};
+			// whether a box reaches more than slack into a solid block, blocks span c - 0.5 to c + 0.5
+			// ending up inside is judged loosely, being blocked more strictly than the sweep's own rounding
+			constexpr float LOOSE = 1e-3f, STRICT = 1e-5f;
+			auto insideSolid = [&solidAt](const Collision::AABB& box, float slack) {
+				const ivec3 min(glm::floor(box.min + vec3(0.5f + slack))), max(glm::ceil(box.max + vec3(0.5f - slack)) - vec3(1.0f));
+				for (int x = min.x; x <= max.x; x++) {
+					for (int y = min.y; y <= max.y; y++) {
+						for (int z = min.z; z <= max.z; z++) {
+							if (solidAt(ivec3(x, y, z))) return true;
+						}
+					}
+				}
+				return false;
+			};
+
+			std::mt19937 rng(SEED + 1);
+			std::uniform_real_distribution<float> across(8.0f, BENCH_CHUNKS_SIDE * CHUNK_MAX_X - 9.0f);
+			std::uniform_real_distribution<float> height(HEIGHT_BASELINE - CHUNK_MAX_Y, HEIGHT_BASELINE + CHUNK_MAX_Y);
+			std::uniform_real_distribution<float> step(-6.0f, 6.0f);
+
+			int moves = 0, inside = 0, stoppedShort = 0, phantom = 0, split = 0;
+			while (moves < MOVES) {
+				vec3 feet(across(rng), height(rng), across(rng));
+				Collision::AABB start{ feet - vec3(0.3f, 0.0f, 0.3f), feet + vec3(0.3f, 1.8f, 0.3f) };
+				if (insideSolid(start, LOOSE)) continue;
+				moves++;
+
+				const vec3 delta(step(rng), step(rng), step(rng));
+				Collision::AABB box = start;
+				for (int axis : { 1, 0, 2 }) {
+					vec3 along(0.0f);
+					along[axis] = delta[axis];
+					bvec3 blocked;
+					const vec3 moved = Collision::move(chunks, box, along, blocked);
+
+					if (insideSolid(box, LOOSE)) inside++;
+					if (!blocked[axis] && moved[axis] != along[axis]) stoppedShort++;
+					if (blocked[axis]) {
+						Collision::AABB nudged = box;
+						nudged.min[axis] += delta[axis] > 0.0f ? TOUCH : -TOUCH;
+						nudged.max[axis] += delta[axis] > 0.0f ? TOUCH : -TOUCH;
+						if (!insideSolid(nudged, STRICT)) phantom++;
+					}
+				}
+
+				Collision::AABB together = start;
+				bvec3 blocked;
+				Collision::move(chunks, together, delta, blocked);
+				if (together.min != box.min || together.max != box.max) split++;
+			}
+
+			check(inside == 0, "  " + std::to_string(inside) + " of " + std::to_string(moves) + " moves ended inside a block");
+			check(stoppedShort == 0, "  " + std::to_string(stoppedShort) + " stopped short without being blocked");
+			check(phantom == 0, "  " + std::to_string(phantom) + " were blocked with no block in front of them");
+			check(split == 0, "  " + std::to_string(split) + " landed elsewhere moving along all axes at once");
+		}
+
+		void collision() {
+			constexpr int BODIES = 10000;
+			constexpr int TICKS = 60;
+			constexpr float TICK_SECONDS = 1.0f / 60.0f;
+
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			ChunkMap chunks;
+			for (int x = 0; x < BENCH_CHUNKS_SIDE; x++) {
+				for (int y = 0; y < WORLD_CHUNKS_Y; y++) {
+					for (int z = 0; z < BENCH_CHUNKS_SIDE; z++) {
+						chunks.emplace(ivec3(x, y, z), std::make_unique<Chunk>(SEED, x, y, z, noise));
+					}
+				}
+			}
+
+			auto start = Clock::now();
+			for (const auto& entry : chunks) entry.second->getSolidColumns();
+			std::cout << "solid masks: " << elapsedMicros(start) / chunks.size() << "us per chunk\n";
+
+			// player sized boxes anywhere over the chunks, moving up to a sprint sideways and falling
+			std::mt19937 rng(SEED);
+			std::uniform_real_distribution<float> across(2.0f, BENCH_CHUNKS_SIDE * CHUNK_MAX_X - 3.0f);
+			std::uniform_real_distribution<float> height(HEIGHT_BASELINE - CHUNK_MAX_Y, HEIGHT_BASELINE + CHUNK_MAX_Y + 8.0f);
+			std::uniform_real_distribution<float> speed(-8.0f, 8.0f);
+			std::vector<Collision::Body> bodies(BODIES);
+			for (Collision::Body& body : bodies) {
+				vec3 feet(across(rng), height(rng), across(rng));
+				body.box = { feet - vec3(0.3f, 0.0f, 0.3f), feet + vec3(0.3f, 1.8f, 0.3f) };
+				body.velocity = vec3(speed(rng), -20.0f, speed(rng));
+			}
+
+			start = Clock::now();
+			for (int tick = 0; tick < TICKS; tick++) {
+				Collision::moveBodies(chunks, bodies, TICK_SECONDS);
+			}
+			double micros = elapsedMicros(start);
+
+			long long grounded = std::count_if(bodies.begin(), bodies.end(), [](const Collision::Body& body) { return body.velocity.y == 0.0f; });
+			std::cout << "swept boxes: " << BODIES * static_cast<double>(TICKS) / micros << "M moves per second, "
+				<< micros / TICKS << "us per tick for " << BODIES << " bodies, " << grounded << " on the ground\n";
+
+			checkCollision(chunks);
+		}
+
+		// chunks going cold and coming back, each time remeshed, with and without the pool
+		// GL buffers are left out, they cycle through the pool the same way as the rest
+		void pool() {
+			constexpr int CYCLES = 4;
+
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			for (size_t slots : { size_t(0), CHUNK_POOL_SLOTS }) {
+				ChunkPool::getInstance().setCapacity(slots);
+
+				std::vector<std::unique_ptr<Chunk>> chunks;
+				for (int x = 0; x < BENCH_CHUNKS_SIDE; x++) {
+					for (int z = 0; z < BENCH_CHUNKS_SIDE; z++) {
+						chunks.push_back(std::make_unique<Chunk>(SEED, x, SURFACE_SECTION, z, noise));
+						chunks.back()->freeze();
+					}
+				}
+
+				// a strip at a time, like a player walking, so the pool never has to hold them all
+				const ChunkPool& pool = ChunkPool::getInstance();
+				const uint64_t allocations = pool.allocations(), frees = pool.frees();
+				auto start = Clock::now();
+				for (int cycle = 0; cycle < CYCLES; cycle++) {
+					for (int strip = 0; strip < BENCH_CHUNKS_SIDE; strip++) {
+						for (int i = 0; i < BENCH_CHUNKS_SIDE; i++) {
+							Chunk& chunk = *chunks[strip * BENCH_CHUNKS_SIDE + i];
+							chunk.thaw();
+							chunk.buildMesh();
+						}
+						for (int i = 0; i < BENCH_CHUNKS_SIDE; i++) chunks[strip * BENCH_CHUNKS_SIDE + i]->freeze();
+					}
+				}
+				double micros = elapsedMicros(start);
+
+				const double count = static_cast<double>(CYCLES * chunks.size());
+				std::cout << (slots ? "pooled" : "unpooled") << " (" << slots << " slots): "
+					<< micros / count << "us per thaw, mesh and freeze, "
+					<< (pool.allocations() - allocations) / count << " allocations and "
+					<< (pool.frees() - frees) / count << " frees of storage or meshes per chunk\n";
+			}
+		}
+
+		// generating and meshing a square on the worker pool, as World's pipeline does, for a growing number of workers
+		void workers() {
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			std::vector<std::vector<int>> offsets(BENCH_CHUNKS_SIDE * BENCH_CHUNKS_SIDE);
+			for (int i = 0; i < BENCH_CHUNKS_SIDE * BENCH_CHUNKS_SIDE; i++) noise.slice(i / BENCH_CHUNKS_SIDE, i % BENCH_CHUNKS_SIDE, offsets[i]);
+
+			for (unsigned threads = 1; threads <= WorkerPool::defaultThreadCount(); threads *= 2) {
+				WorkerPool pool(threads);
+				std::vector<std::unique_ptr<Chunk>> chunks(offsets.size());
+				size_t meshed = 0;
+
+				// each chunk is meshed on its own, borders included, once generated
+				auto start = Clock::now();
+				for (size_t i = 0; i < offsets.size(); i++) {
+					pool.submit([&offsets, &chunks, &pool, &meshed, i]() -> WorkerPool::Finish {
+						auto chunk = std::make_shared<std::unique_ptr<Chunk>>(
+							std::make_unique<Chunk>(SEED, int(i) / BENCH_CHUNKS_SIDE, SURFACE_SECTION, int(i) % BENCH_CHUNKS_SIDE, offsets[i]));
+						return [&chunks, &pool, &meshed, i, chunk]() {
+							chunks[i] = std::move(*chunk);
+							Chunk::Snapshot snapshot = chunks[i]->snapshot();
+							pool.submit([&meshed, snapshot]() -> WorkerPool::Finish {
+								auto vertices = std::make_shared<std::vector<Vertex>>(Chunk::meshSnapshot(snapshot, {}, nullptr));
+								return [&meshed, vertices]() {
+									meshed++;
+									ChunkPool::getInstance().giveMesh(std::move(*vertices));
+								};
+							});
+						};
+					});
+				}
+				while (meshed < chunks.size()) {
+					pool.waitForAny();
+					pool.finishCompleted();
+				}
+				double micros = elapsedMicros(start);
+
+				std::cout << threads << " workers: " << micros / chunks.size() << "us per chunk generated and meshed\n";
+			}
+		}
+
+		// appending edits, recovering from a crash that left only the log and a torn record, then compacting
+		void journal() {
+			constexpr int EDITS = 20000;
+			const std::string directory = "saves/bench-journal";
+			std::error_code error;
+			std::filesystem::remove_all(directory, error);
+
+			std::mt19937 rng(SEED);
+			std::uniform_int_distribution<int> chunk(0, BENCH_CHUNKS_SIDE - 1), section(0, WORLD_CHUNKS_Y - 1);
+			std::uniform_int_distribution<int> x(0, CHUNK_MAX_X - 1), y(0, CHUNK_MAX_Y - 1), z(0, CHUNK_MAX_Z - 1);
+			{
+				EditJournal journal(directory);
+				auto start = Clock::now();
+				for (int i = 0; i < EDITS; i++) {
+					journal.record(ivec3(chunk(rng), section(rng), chunk(rng)), ivec3(x(rng), y(rng), z(rng)), i % 2 ? GRASS : 0);
+				}
+				double micros = elapsedMicros(start);
+				std::cout << "append: " << micros / EDITS << "us per edit, " << journal.logBytes() / double(EDITS) << " bytes per edit\n";
+
+				// what a crash would leave, the deltas the journal writes on close are thrown away below
+				std::filesystem::copy_file(directory + "/journal.log", directory + "/crashed.log", error);
+			}
+			for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+				if (entry.path().extension() == ".delta") std::filesystem::remove(entry.path(), error);
+			}
+			std::filesystem::rename(directory + "/crashed.log", directory + "/journal.log", error);
+			FILE* log = std::fopen((directory + "/journal.log").c_str(), "ab");
+			std::fputs("torn", log);
+			std::fclose(log);
+
+			{
+				EditJournal recovered(directory);
+				const EditJournal::Stats& stats = recovered.getStats();
+				std::cout << "recovery: " << stats.replayed << " of " << EDITS << " edits replayed in " << stats.openMicros / 1000.0 << "ms, "
+					<< stats.dropped << " torn bytes dropped\n";
+
+				auto start = Clock::now();
+				recovered.compact();
+				double micros = elapsedMicros(start);
+				uintmax_t deltaBytes = 0;
+				for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+					if (entry.path().extension() == ".delta") deltaBytes += entry.file_size(error);
+				}
+				std::cout << "compaction: " << micros / 1000.0 << "ms for " << stats.deltasWritten << " chunk deltas, "
+					<< deltaBytes / 1024 << "KB on disk\n";
+			}
+			{
+				// the deltas alone, as a later session opens them
+				EditJournal reopened(directory);
+				std::cout << "reopen: " << reopened.getStats().openMicros / 1000.0 << "ms\n";
+				reopened.printStats(std::cout);
+			}
+
+			std::filesystem::remove_all(directory, error);
+		}
+
+		// a server and client over loopback, stepped in turn on this thread so the server's counters can be read
+		void network() {
+			constexpr uint16_t port = DEFAULT_PORT + 1; // leaves the default free for a running server
+			constexpr int radius = RENDER_DISTANCE / 2;
+			constexpr int EDITS = 1000;
+
+			ChunkServer server(SEED, false, false);
+			if (!server.listen(port)) return;
+			std::optional<Net::Connection> connection = Net::Connection::connect(port);
+			if (!connection) return;
+			ChunkClient client(std::move(*connection));
+
+			auto exchange = [&]() {
+				client.poll();
+				server.step(0);
+				client.poll(1);
+			};
+
+			// every chunk in the box, checking they come nearest first
+			const ivec3 center(0, SURFACE_SECTION, 0);
+			const int layers = std::min(center.y + VERTICAL_RADIUS, WORLD_CHUNKS_Y - 1) - std::max(center.y - VERTICAL_RADIUS, 0) + 1;
+			const int expected = (2 * radius + 1) * (2 * radius + 1) * layers;
+			int received = 0, outOfOrder = 0, lastDistance = 0;
+			std::vector<Protocol::ChunkData> chunks;
+			auto start = Clock::now();
+			client.subscribe(center, radius, VERTICAL_RADIUS);
+			while (received < expected && client.isConnected()) {
+				exchange();
+				while (client.hasUpdate()) {
+					ChunkClient::Update update = client.takeUpdate();
+					Chunk chunk(update.chunk.coords.x, update.chunk.coords.y, update.chunk.coords.z, update.chunk.blocks);
+					ivec3 offset = update.chunk.coords - center;
+					int distance = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+					if (distance < lastDistance) outOfOrder++;
+					lastDistance = distance;
+					received++;
+					chunks.push_back(std::move(update.chunk));
+				}
+			}
+			double micros = elapsedMicros(start);
+			std::cout << "subscribe: " << received << " chunks in " << micros / 1000.0 << "ms, "
+				<< client.getBytesReceived() / std::max(received, 1) << " bytes per chunk on the wire against "
+				<< CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z << " raw, " << outOfOrder << " out of nearest first order\n";
+
+			// a client must end up with exactly the blocks it would have generated itself
+			Noise::TileCache noise(SEED, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES);
+			int differing = 0;
+			for (const Protocol::ChunkData& data : chunks) {
+				const ivec3 coords = data.coords;
+				Chunk remote(coords.x, coords.y, coords.z, data.blocks);
+				Chunk local(SEED, coords.x, coords.y, coords.z, noise);
+				bool same = true;
+				for (int z = 0; z < CHUNK_MAX_Z && same; z++) {
+					for (int y = 0; y < CHUNK_MAX_Y && same; y++) {
+						for (int x = 0; x < CHUNK_MAX_X && same; x++) same = remote.getBlock({ x, y, z }) == local.getBlock({ x, y, z });
+					}
+				}
+				if (!same) differing++;
+			}
+			check(received == expected && differing == 0, std::to_string(differing) + " of " + std::to_string(received) + " received chunks differ from local generation");
+
+			// each edit waits for its delta before the next, alternating a lamp and air at the top of the spawn chunk
+			for (int i = 0; i < EDITS && client.isConnected(); i++) {
+				ivec3 position(i % CHUNK_MAX_X, (center.y + 1) * CHUNK_MAX_Y - 1, (i / CHUNK_MAX_X) % CHUNK_MAX_Z);
+				uint64_t before = client.getEditLatency().count;
+				client.edit(position, (i / (CHUNK_MAX_X * CHUNK_MAX_Z)) % 2 ? 0 : LAMP);
+				while (client.getEditLatency().count == before && client.isConnected()) exchange();
+				while (client.hasUpdate()) client.takeUpdate();
+			}
+			const LatencyStats& edits = client.getEditLatency();
+			std::cout << "edits: " << edits.count << " round trips, " << edits.averageMillis() * 1000.0 << "us avg, "
+				<< edits.maxMillis() * 1000.0 << "us max\n";
+
+			// a client that stops reading is only sent what fits in the high water mark and the socket buffers
+			client.subscribe(center, MAX_SUBSCRIBE_RADIUS, VERTICAL_RADIUS);
+			uint64_t sentBefore = server.getChunksSent();
+			client.poll();
+			for (int i = 0; i < 200; i++) server.step(1);
+			std::cout << "backpressure: " << server.getChunksSent() - sentBefore << " of "
+				<< (2 * MAX_SUBSCRIBE_RADIUS + 1) * (2 * MAX_SUBSCRIBE_RADIUS + 1) * layers - expected
+				<< " chunks sent to a client that stopped reading\n";
+
+			server.printStats(std::cout);
+			client.printStats(std::cout);
+		}
+
+		const std::map<std::string, std::function<void()>>& benchmarks() {
+			static const std::map<std::string, std::function<void()>> all = {
+				{ "terrain", terrain },
+				{ "collision", collision },
+				{ "layouts", layouts },
+				{ "light", light },
+				{ "noise", noise },
+				{ "pool", pool },
+				{ "network", network },
+				{ "workers", workers },
+				{ "journal", journal },
+			};
+			return all;
+		}
+	}
+
+	int run(const std::string& name) {
+		auto it = benchmarks().find(name);
+		if (it == benchmarks().end()) {
+			std::cout << "Unknown benchmark \"" << name << "\", available:";
+			for (const auto& entry : benchmarks()) std::cout << " " << entry.first;
+			std::cout << std::endl;
+			return 1;
+		}
+
+		std::cout << "Running benchmark " << name << std::endl;
+		failed = false;
+		it->second();
+		return failed ? 1 : 0;
+	}
+}
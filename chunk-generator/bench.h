@@ -0,0 +1,13 @@
+#pragma once
+
+#include <string>
+
+/*
+Offline benchmarks, run with --bench <name>
+They never open a window, so anything needing GL is left out
+Some also check what they measured against a slower exact answer, a failed check fails the run
+*/
+namespace Bench {
+	// returns the exit code for main, 1 if a benchmark's check failed, lists the benchmarks if name is unknown
+	int run(const std::string& name);
+}
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 
 #include <bitset>
+#include <cassert>
 #include <initializer_list>
 #include <iostream>
 #include <string>
@@ -34,17 +35,24 @@ namespace Block {
         }
     }
 
+    // no more than this many types fit in a mesh vertex and the shader's face layer table
+    static constexpr int MAX_BLOCK_TYPES = 64;
+
     struct BlockDef {
         std::string name;
+        // texture array layer per face, in cubeVertices order: front, back, left, right, top, bottom
         int textureIndices[6]{};
         std::bitset<static_cast<size_t>(BlockTag::COUNT)> tags;
+        // block light level it gives off, 0 to 15
+        uint8_t lightEmission = 0;
 
         // Constructor to allow more convenient syntax
         BlockDef(
             std::string name, 
             std::initializer_list<int> textures, 
-            std::initializer_list<BlockTag> tagList)
-            : name(std::move(name)) {
+            std::initializer_list<BlockTag> tagList,
+            uint8_t lightEmission = 0)
+            : name(std::move(name)), lightEmission(lightEmission) {
             assert(textures.size() == 6);
             int i = 0;
             for (auto t : textures) {
@@ -89,14 +97,29 @@ namespace Block {
         }
 
         inline void registerBlock(BlockDef def) {
+            assert(blockDefs.size() < MAX_BLOCK_TYPES);
             blockDefs.push_back(std::move(def));
             uniqueID++;
         }
 
+        // returns the texture array layer the image will be loaded into
+        inline int registerTexture(std::string path) {
+            texturePaths.push_back(std::move(path));
+            return static_cast<int>(texturePaths.size()) - 1;
+        }
+
+        inline const std::vector<std::string>& getTexturePaths() const {
+            return texturePaths;
+        }
+
         inline const BlockDef& getDef(BlockType type) const {
             return blockDefs.at(type);
         }
 
+        inline size_t size() const {
+            return blockDefs.size();
+        }
+
         inline void print() const {
             for (const auto& def : blockDefs) {
                 std::cout << def << "\n";
@@ -108,6 +131,7 @@ namespace Block {
     private:
         BlockType uniqueID = 0;
         std::vector<BlockDef> blockDefs;
+        std::vector<std::string> texturePaths;
         BlockRegistry() = default;
     };
 
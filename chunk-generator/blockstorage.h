@@ -0,0 +1,220 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "block.h"
+
+using glm::ivec3;
+
+/*
+Layout policies map a block's (x, y, z) to an index in a chunk's block array
+All of them are constexpr, with power of 2 dimensions the index math is only shifts and masks
+forEach visits every block in memory order, which is the order loops should walk them in
+*/
+namespace Layout {
+	constexpr int log2Ceil(int value) {
+		int bits = 0;
+		while ((1 << bits) < value) bits++;
+		return bits;
+	}
+
+	// x fastest, then y, then z
+	template <int SX, int SY, int SZ>
+	struct XMajor {
+		static constexpr int volume = SX * SY * SZ;
+
+		static constexpr int index(int x, int y, int z) {
+			return x + SX * (y + SY * z);
+		}
+
+		template <typename F>
+		static void forEach(F&& f) {
+			for (int z = 0; z < SZ; z++)
+				for (int y = 0; y < SY; y++)
+					for (int x = 0; x < SX; x++)
+						f(x, y, z);
+		}
+	};
+
+	// y fastest so every column is contiguous, matching how terrain is filled
+	template <int SX, int SY, int SZ>
+	struct YMajor {
+		static constexpr int volume = SX * SY * SZ;
+
+		static constexpr int index(int x, int y, int z) {
+			return y + SY * (x + SX * z);
+		}
+
+		template <typename F>
+		static void forEach(F&& f) {
+			for (int z = 0; z < SZ; z++)
+				for (int x = 0; x < SX; x++)
+					for (int y = 0; y < SY; y++)
+						f(x, y, z);
+		}
+	};
+
+	// Z-order curve, neighbours in every direction stay close in memory
+	// each dimension is padded up to a power of 2 and their bits are interleaved x, y, z
+	template <int SX, int SY, int SZ>
+	struct Morton {
+		static constexpr int BITS_X = log2Ceil(SX);
+		static constexpr int BITS_Y = log2Ceil(SY);
+		static constexpr int BITS_Z = log2Ceil(SZ);
+
+		static constexpr int volume = 1 << (BITS_X + BITS_Y + BITS_Z);
+
+		// where each bit of one axis lands once interleaved
+		static constexpr int spread(int value, int axis) {
+			const int bits[3] = { BITS_X, BITS_Y, BITS_Z };
+			int result = 0;
+			int bit = 0;
+			for (int i = 0; i < bits[0] || i < bits[1] || i < bits[2]; i++) {
+				for (int a = 0; a < 3; a++) {
+					if (i >= bits[a]) continue;
+					if (a == axis) result |= ((value >> i) & 1) << bit;
+					bit++;
+				}
+			}
+			return result;
+		}
+
+		template <int N>
+		static constexpr std::array<int, N> spreadTable(int axis) {
+			std::array<int, N> table{};
+			for (int i = 0; i < N; i++) table[i] = spread(i, axis);
+			return table;
+		}
+
+		// the interleaving is done at compile time, an index is three lookups and two ors
+		static constexpr std::array<int, SX> SPREAD_X = spreadTable<SX>(0);
+		static constexpr std::array<int, SY> SPREAD_Y = spreadTable<SY>(1);
+		static constexpr std::array<int, SZ> SPREAD_Z = spreadTable<SZ>(2);
+
+		static constexpr int index(int x, int y, int z) {
+			return SPREAD_X[x] | SPREAD_Y[y] | SPREAD_Z[z];
+		}
+
+		// x is the lowest interleaved bit, so walking x fastest stays within small bricks
+		template <typename F>
+		static void forEach(F&& f) {
+			for (int z = 0; z < SZ; z++)
+				for (int y = 0; y < SY; y++)
+					for (int x = 0; x < SX; x++)
+						f(x, y, z);
+		}
+	};
+}
+
+// A fixed size box of blocks stored with the given layout
+// T defaults to block types, other per block data like light can share the layout
+template <int SX, int SY, int SZ, template <int, int, int> class LayoutPolicy, typename T = Block::BlockType>
+class BlockStorage
+{
+public:
+	using Layout = LayoutPolicy<SX, SY, SZ>;
+
+	static constexpr int SIZE_X = SX;
+	static constexpr int SIZE_Y = SY;
+	static constexpr int SIZE_Z = SZ;
+
+	BlockStorage() : blocks(Layout::volume, 0) {}
+
+	// zeroed, reusing the allocation of storage, see ChunkPool
+	explicit BlockStorage(std::vector<T>&& storage) : blocks(std::move(storage)) {
+		blocks.assign(Layout::volume, 0);
+	}
+
+	// holds nothing and allocates nothing, for chunks whose blocks follow from something smaller until edited
+	struct Empty {};
+	explicit BlockStorage(Empty) {}
+
+	static constexpr bool inBounds(int x, int y, int z) {
+		return x >= 0 && x < SX && y >= 0 && y < SY && z >= 0 && z < SZ;
+	}
+
+	// unchecked, for loops that already stay inside the box
+	static constexpr int index(int x, int y, int z) {
+		return Layout::index(x, y, z);
+	}
+
+	// -1 when out of bounds
+	static constexpr int checkedIndex(const ivec3& coords) {
+		return inBounds(coords.x, coords.y, coords.z) ? index(coords.x, coords.y, coords.z) : -1;
+	}
+
+	inline T get(int x, int y, int z) const {
+		return blocks[index(x, y, z)];
+	}
+
+	inline void set(int x, int y, int z, T type) {
+		blocks[index(x, y, z)] = type;
+	}
+
+	inline T& operator[](int i) {
+		return blocks[i];
+	}
+
+	inline T operator[](int i) const {
+		return blocks[i];
+	}
+
+	// fills y in [fromY, toY) of one column
+	inline void fillColumn(int x, int z, int fromY, int toY, T type) {
+		for (int y = fromY; y < toY; y++) blocks[index(x, y, z)] = type;
+	}
+
+	// raw blocks in layout order, for hashing and serializing
+	inline const T* data() const {
+		return blocks.data();
+	}
+
+	inline size_t byteSize() const {
+		return blocks.size() * sizeof(T);
+	}
+
+	// run length encoding of the blocks in layout order as (length, type) byte pairs
+	// with a column major layout most terrain columns come out as a couple of runs
+	inline std::vector<uint8_t> compress() const {
+		static_assert(sizeof(T) == 1, "runs store values as single bytes");
+		std::vector<uint8_t> runs;
+		for (size_t i = 0; i < blocks.size();) {
+			size_t length = 1;
+			while (i + length < blocks.size() && length < 255 && blocks[i + length] == blocks[i]) length++;
+			runs.push_back(static_cast<uint8_t>(length));
+			runs.push_back(static_cast<uint8_t>(blocks[i]));
+			i += length;
+		}
+		return runs;
+	}
+
+	inline void decompress(const std::vector<uint8_t>& runs) {
+		blocks.clear();
+		blocks.reserve(Layout::volume);
+		for (size_t i = 0; i + 1 < runs.size(); i += 2) blocks.insert(blocks.end(), runs[i], static_cast<T>(runs[i + 1]));
+	}
+
+	// gives up the blocks and their allocation, nothing may be read or written until the next decompress
+	inline std::vector<T> takeStorage() {
+		std::vector<T> storage;
+		storage.swap(blocks);
+		return storage;
+	}
+
+	// an allocation for the next decompress to fill, its contents are dropped
+	inline void adoptStorage(std::vector<T>&& storage) {
+		blocks = std::move(storage);
+		blocks.clear();
+	}
+
+	inline bool isResident() const {
+		return !blocks.empty();
+	}
+
+private:
+	std::vector<T> blocks;
+};
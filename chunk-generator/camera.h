@@ -109,6 +109,15 @@ public:
         updateCameraVectors();
     }
 
+    // jumps straight to a position and orientation, for replaying a recorded path
+    void SetPose(vec3 position, float yaw, float pitch)
+    {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
     void ProcessMouseScroll(float yoffset)
     {
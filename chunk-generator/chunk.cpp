@@ -1,162 +1,408 @@
 #include "chunk.h"
 
-Chunk::Chunk(uint32_t seed, int worldx, int worldz) : seed(seed), worldx(worldx), worldz(worldz) {
-	blocks.resize(CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z);
-	generate(6); // for perlin noise
+#include <algorithm>
+#include <utility>
+
+#include "chunkpool.h"
+#include "light.h"
+#include "mesher.h"
+#include "profiler.h"
+#include "uploader.h"
+
+std::shared_ptr<const Heightmap> Heightmap::filledTo(int height) {
+	static const std::shared_ptr<const Heightmap> sky = std::make_shared<Heightmap>();
+	static const std::shared_ptr<const Heightmap> ground = []() {
+		auto filled = std::make_shared<Heightmap>();
+		filled->heights.fill(CHUNK_MAX_Y);
+		return filled;
+	}();
+	return height == 0 ? sky : ground;
+}
 
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
+Chunk::Chunk(uint32_t seed, int worldx, int worldy, int worldz, Noise::TileCache & noise) :
+	blocks(ChunkBlocks::Empty{}), light(ChunkLight::Empty{}), seed(seed), worldx(worldx), worldy(worldy), worldz(worldz) {
+	vector<int> offsets;
+	noise.slice(worldx, worldz, offsets);
+	generate(offsets);
 
-	glBindVertexArray(VAO);
+	//std::cerr << "Chunk at (" << worldx << ", " << worldz << ") constructed successfully!" << std::endl;
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+Chunk::Chunk(uint32_t seed, int worldx, int worldy, int worldz, const vector<int> & offsets) :
+	blocks(ChunkBlocks::Empty{}), light(ChunkLight::Empty{}), seed(seed), worldx(worldx), worldy(worldy), worldz(worldz) {
+	generate(offsets);
+}
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-	glEnableVertexAttribArray(0);
+Chunk::Chunk(uint32_t seed, int worldx, int worldy, int worldz, const Density::Plan & terrain) :
+	blocks(ChunkPool::getInstance().takeBlocks()), light(ChunkPool::getInstance().takeLight()), seed(seed), worldx(worldx), worldy(worldy), worldz(worldz) {
+	generate(terrain);
+	flattenIfUniform();
+}
 
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-	glEnableVertexAttribArray(1);
+Chunk::Chunk(int worldx, int worldy, int worldz, const vector<uint8_t>& runs) :
+	blocks(ChunkPool::getInstance().takeBlocks()), light(ChunkPool::getInstance().takeLight()), seed(0), worldx(worldx), worldy(worldy), worldz(worldz) {
+	blocks.write().decompress(runs);
+	flattenIfUniform();
+}
 
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
-	glEnableVertexAttribArray(2);
+Chunk::~Chunk() {
+	releaseBuffers();
+}
 
-	updateMesh();
-	glBindVertexArray(0);
+void Chunk::releaseBuffers() {
+	ChunkPool::getInstance().giveBuffers({ VAO, VBO, bufferBytes });
+	VAO = VBO = 0;
+	uploadedVertices = 0;
+	bufferBytes = 0;
+}
 
-	//std::cerr << "Chunk at (" << worldx << ", " << worldz << ") constructed successfully!" << std::endl;
+void Chunk::freeze() {
+	if (isCold()) return;
+	PROFILE_SCOPE("Chunk::freeze");
+
+	// storage that is still only the heightmap has nothing to keep
+	ChunkPool& pool = ChunkPool::getInstance();
+	if (blocks.read().isResident()) {
+		compressedBlocks = blocks.read().compress();
+		compressedBlocks.shrink_to_fit();
+		pool.giveBlocks(blocks.write().takeStorage());
+	}
+	if (light.read().isResident()) {
+		compressedLight = light.read().compress();
+		compressedLight.shrink_to_fit();
+		pool.giveLight(light.write().takeStorage());
+	}
+	cold = true;
+	version++;
+	pool.giveMesh(std::exchange(meshVertices, {}));
+	vector<uint64_t>().swap(solidColumns);
+
+	releaseBuffers();
 }
 
-Chunk::~Chunk() {
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
+void Chunk::thaw() {
+	if (!isCold()) return;
+	PROFILE_SCOPE("Chunk::thaw");
+
+	ChunkPool& pool = ChunkPool::getInstance();
+	if (!compressedBlocks.empty()) {
+		blocks.write().adoptStorage(pool.takeBlocks());
+		blocks.write().decompress(compressedBlocks);
+		vector<uint8_t>().swap(compressedBlocks);
+	}
+	if (!compressedLight.empty()) {
+		light.write().adoptStorage(pool.takeLight());
+		light.write().decompress(compressedLight);
+		vector<uint8_t>().swap(compressedLight);
+	}
+	cold = false;
+	version++;
+}
+
+void Chunk::materializeBlocks() {
+	PROFILE_SCOPE("Chunk::materializeBlocks");
+	ChunkBlocks& storage = blocks.write();
+	storage = ChunkBlocks(ChunkPool::getInstance().takeBlocks());
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		for (int x = 0; x < CHUNK_MAX_X; x++) storage.fillColumn(x, z, 0, heightmap->height(x, z), Heightmap::BLOCK);
+	}
+}
+
+void Chunk::materializeLight() {
+	PROFILE_SCOPE("Chunk::materializeLight");
+	ChunkLight& storage = light.write();
+	storage = ChunkLight(ChunkPool::getInstance().takeLight());
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		for (int x = 0; x < CHUNK_MAX_X; x++) storage.fillColumn(x, z, heightmap->height(x, z), CHUNK_MAX_Y, Heightmap::SKY_LIGHT);
+	}
+}
+
+void Chunk::flattenIfUniform() {
+	const ChunkBlocks& storage = blocks.read();
+	const Block::BlockType first = storage[0];
+	if (first != 0 && first != Heightmap::BLOCK) return;
+	if (!std::all_of(storage.data(), storage.data() + ChunkBlocks::Layout::volume, [first](Block::BlockType type) { return type == first; }))
+		return;
+
+	// light isn't worked out yet, a uniform chunk's follows from its heights like any heightmap chunk's
+	ChunkPool& pool = ChunkPool::getInstance();
+	pool.giveBlocks(blocks.write().takeStorage());
+	pool.giveLight(light.write().takeStorage());
+	heightmap = Heightmap::filledTo(first == 0 ? 0 : CHUNK_MAX_Y);
+}
+
+vector<uint8_t> Chunk::compressBlocks() const {
+	if (blocks.read().isResident()) return blocks.read().compress();
+
+	ChunkBlocks storage(ChunkPool::getInstance().takeBlocks());
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		for (int x = 0; x < CHUNK_MAX_X; x++) storage.fillColumn(x, z, 0, heightmap->height(x, z), Heightmap::BLOCK);
+	}
+	vector<uint8_t> runs = storage.compress();
+	ChunkPool::getInstance().giveBlocks(storage.takeStorage());
+	return runs;
 }
 
 void Chunk::draw() const {
+	if (uploadedVertices == 0) return;
+
 	glBindVertexArray(VAO);
-	glDrawArrays(GL_TRIANGLES, 0, meshVertices.size());
+	glDrawArrays(GL_TRIANGLES, 0, uploadedVertices);
 }
 
-void Chunk::updateMesh() {
-	meshVertices.clear();
-	meshVertices.reserve(CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z * 6 * 4 / 2);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	//glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshVertices.size(), meshVertices.data(), GL_DYNAMIC_DRAW);
+Chunk::Snapshot Chunk::snapshot() const {
+	if (isCold()) return {};
+	return {
+		blocks.read().isResident() ? blocks.snapshot() : nullptr,
+		light.read().isResident() ? light.snapshot() : nullptr,
+		heightmap,
+		version
+	};
+}
+
+void Chunk::buildMesh(MeshCache* cache, const Neighbours& neighbours) {
+	NeighbourSnapshots neighbourSnapshots;
+	for (int face = 0; face < 6; face++) {
+		if (neighbours[face] != nullptr) neighbourSnapshots[face] = neighbours[face]->snapshot();
+	}
 
-	int currentIndex = 0;
+	acceptMesh(meshSnapshot(snapshot(), neighbourSnapshots, cache), version);
+}
 
-	for (int x = 0; x < CHUNK_MAX_X; x++) {
-		for (int y = 0; y < CHUNK_MAX_Y; y++) {
-			for (int z = 0; z < CHUNK_MAX_Z; z++) {
-				addBlockMesh({ x, y, z });
+bool Chunk::acceptMesh(vector<Vertex>&& vertices, uint64_t builtFrom) {
+	if (builtFrom != version) {
+		ChunkPool::getInstance().giveMesh(std::move(vertices));
+		return false;
+	}
+	ChunkPool::getInstance().giveMesh(std::exchange(meshVertices, std::move(vertices)));
+	return true;
+}
+
+vector<Vertex> Chunk::meshSnapshot(const Snapshot& chunk, const NeighbourSnapshots& neighbours, MeshCache* cache) {
+	PROFILE_SCOPE("Chunk::buildMesh");
+	vector<Vertex> vertices = ChunkPool::getInstance().takeMesh();
+	if (!chunk.blocks && !chunk.heights) return vertices;
+
+	static const Mesher::TagTable tags;
+	static_assert(Heightmap::SKY_LIGHT == Light::OPEN_SKY, "heightmap chunks must light like the light engine");
+
+	// chunks that aren't loaded are open sky and hide nothing
+	auto lightAt = [](const Snapshot& snapshot, ivec3 cell) -> uint8_t {
+		if (snapshot.light) return snapshot.light->get(cell.x, cell.y, cell.z);
+		return snapshot.heights ? snapshot.heights->light(cell.x, cell.y, cell.z) : Light::OPEN_SKY;
+	};
+	auto opaqueAt = [](const Snapshot& snapshot, ivec3 cell) {
+		if (snapshot.blocks) return !tags.transparent[snapshot.blocks->get(cell.x, cell.y, cell.z)];
+		return snapshot.heights && snapshot.heights->get(cell.x, cell.y, cell.z) != 0;
+	};
+
+	// meshing from the heights is cheaper than reading a mesh back, only chunks with blocks use the cache
+	// the key covers the side of every neighbour facing this chunk, since border faces depend on it
+	uint64_t hash = 0;
+	if (cache && chunk.blocks) {
+		constexpr int SIDE_CELLS = CHUNK_MAX_X * CHUNK_MAX_Y;
+		vector<uint8_t> sides(2 * 6 * SIDE_CELLS);
+		for (int face = 0; face < 6; face++) {
+			for (int v = 0; v < CHUNK_MAX_X; v++) {
+				for (int u = 0; u < CHUNK_MAX_X; u++) {
+					ivec3 cell = Mesher::sideCell<CHUNK_MAX_X>(face ^ 1, u, v); // faces come in +/- pairs
+					sides[2 * (face * SIDE_CELLS + u + CHUNK_MAX_X * v)] = lightAt(neighbours[face], cell);
+					sides[2 * (face * SIDE_CELLS + u + CHUNK_MAX_X * v) + 1] = opaqueAt(neighbours[face], cell);
+				}
 			}
 		}
+
+		hash = MeshCache::hashBytes(chunk.blocks->data(), chunk.blocks->byteSize());
+		hash = chunk.light
+			? MeshCache::hashBytes(chunk.light->data(), chunk.light->byteSize(), hash)
+			: MeshCache::hashBytes(chunk.heights->heights.data(), chunk.heights->heights.size(), hash);
+		hash = MeshCache::hashBytes(sides.data(), sides.size(), hash);
+		if (cache->load(hash, vertices)) return vertices;
 	}
 
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshVertices.size(), meshVertices.data(), GL_DYNAMIC_DRAW);
-	glBindVertexArray(0);
-}
+	// pooled vectors keep the capacity of an earlier mesh, so only fresh ones grow while faces are added
+	auto emitFace = [&](int x, int y, int z, int face, Block::BlockType type) {
+		ivec3 next(x + Mesher::FACE_OFFSETS[face][0], y + Mesher::FACE_OFFSETS[face][1], z + Mesher::FACE_OFFSETS[face][2]);
+
+		// a face is lit by the cell in front of it, border faces against a solid neighbour are never seen
+		uint8_t faceLight;
+		if (ChunkLight::inBounds(next.x, next.y, next.z)) {
+			faceLight = lightAt(chunk, next);
+		}
+		else {
+			const int* offset = Mesher::FACE_OFFSETS[face];
+			const ivec3 wrapped = next - ivec3(offset[0] * CHUNK_MAX_X, offset[1] * CHUNK_MAX_Y, offset[2] * CHUNK_MAX_Z);
+			if (opaqueAt(neighbours[face], wrapped)) return;
+			faceLight = lightAt(neighbours[face], wrapped);
+		}
+
+		addFace(vertices, { x, y, z }, face, type, faceLight);
+	};
 
-void Chunk::addBlockMesh(ivec3 coords) {
-	using namespace Block;
-	if (getBlockDef(coords).hasTag(BlockTag::Air)) return;
+	if (chunk.blocks) {
+		const ChunkBlocks& blocks = *chunk.blocks;
+		Mesher::forEachVisibleFace(blocks, tags, [&](int x, int y, int z, int face) {
+			emitFace(x, y, z, face, blocks.get(x, y, z));
+		});
+	}
+	else {
+		Mesher::forEachColumnFace<CHUNK_MAX_X, CHUNK_MAX_Z>(*chunk.heights, [&](int x, int y, int z, int face) {
+			emitFace(x, y, z, face, Heightmap::BLOCK);
+		});
+	}
 
-	if (getBlockDef(coords + ivec3(0, 0, 1)).hasTag(BlockTag::Transparent)) addFace(coords, 0); // front
-	if (getBlockDef(coords + ivec3(0, 0, -1)).hasTag(BlockTag::Transparent)) addFace(coords, 1); // back
-	if (getBlockDef(coords + ivec3(-1, 0, 0)).hasTag(BlockTag::Transparent)) addFace(coords, 2); // left
-	if (getBlockDef(coords + ivec3(1, 0, 0)).hasTag(BlockTag::Transparent)) addFace(coords, 3); // right
-	if (getBlockDef(coords + ivec3(0, 1, 0)).hasTag(BlockTag::Transparent)) addFace(coords, 4); // top
-	if (getBlockDef(coords + ivec3(0, -1, 0)).hasTag(BlockTag::Transparent)) addFace(coords, 5); // bottom
+	if (cache && chunk.blocks) cache->store(hash, vertices);
+	return vertices;
 }
 
-void Chunk::addFace(ivec3 coords, int index) {
-	int start = index * 6;
+void Chunk::uploadMesh() {
+	PROFILE_SCOPE("Chunk::uploadMesh");
+	// most of a tall world is sky or underground and meshes to nothing, those never get buffers
+	if (meshVertices.empty() && VAO == 0) {
+		uploadedVertices = 0;
+		return;
+	}
 
-	for (int i = 0; i < 6; i++) {
-		Vertex vertex = Block::cubeVertices[start + i];
-		vertex.coords += coords;
-		meshVertices.push_back(vertex);
+	if (VAO == 0) {
+		ChunkPool::Buffers buffers = ChunkPool::getInstance().takeBuffers();
+		VAO = buffers.VAO;
+		VBO = buffers.VBO;
+		bufferBytes = buffers.bytes;
 	}
+
+	// storage is only reallocated when the mesh outgrows it, with room to spare for edits
+	const GLsizeiptr bytes = sizeof(Vertex) * meshVertices.size();
+	if (bytes > bufferBytes) {
+		bufferBytes = bytes + bytes / 4;
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, bufferBytes, nullptr, GL_STATIC_DRAW);
+	}
+	Uploader::getInstance().upload(VBO, meshVertices.data(), bytes);
+
+	uploadedVertices = meshVertices.size();
+
+	// the GPU has its own copy now, edits rebuild the mesh from the blocks anyway
+	ChunkPool::getInstance().giveMesh(std::exchange(meshVertices, {}));
 }
 
-void Chunk::generate(int octaves) {
-	// go through again and assign a height offset
-	vector<int> offsets(CHUNK_MAX_X * CHUNK_MAX_Z);
+const vector<uint64_t>& Chunk::getSolidColumns() const {
+	static_assert(CHUNK_MAX_Y <= 64, "a column's solid blocks must fit in one mask");
+	if (solidColumnsVersion == version) return solidColumns;
 
-	float frequency = INITIAL_FREQUENCY;
-	int amplitude = INITIAL_AMPLITUDE;
+	PROFILE_SCOPE("Chunk::getSolidColumns");
+	static const Mesher::TagTable tags;
+	const ChunkBlocks& storage = blocks.read();
 
-	for (int i = 0; i < octaves; i++) {
-		perlinNoise(frequency, amplitude, offsets);
-		frequency /= 2;
-		amplitude /= 2;
+	solidColumns.assign(CHUNK_MAX_X * CHUNK_MAX_Z, 0);
+	if (!storage.isResident()) {
+		for (int i = 0; i < CHUNK_MAX_X * CHUNK_MAX_Z; i++) solidColumns[i] = (uint64_t(1) << heightmap->heights[i]) - 1;
+		solidColumnsVersion = version;
+		return solidColumns;
 	}
 
-	// go through each (x, z) and set the height, using a baseline height
-	// then, fills air above each height, and grass below
-	for (int x = 0; x < CHUNK_MAX_X; x++) {
-		for (int z = 0; z < CHUNK_MAX_Z; z++) {
-			int height = HEIGHT_BASELINE + offsets[x + CHUNK_MAX_X * z];
-
-			for (int y = 0; y < height; y++) {
-				blocks[x + CHUNK_MAX_X * (y + CHUNK_MAX_Y * z)] = 1; //TODO: Replace with different blocks
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		for (int x = 0; x < CHUNK_MAX_X; x++) {
+			uint64_t mask = 0;
+			for (int y = 0; y < CHUNK_MAX_Y; y++) {
+				if (!tags.air[storage.get(x, y, z)]) mask |= uint64_t(1) << y;
 			}
+			solidColumns[x + CHUNK_MAX_X * z] = mask;
 		}
 	}
+
+	solidColumnsVersion = version;
+	return solidColumns;
+}
+
+void Chunk::reportMemory(MemoryReport& report) const {
+	report.add("chunks", isCold() ? "cold" : "hot", 1);
+	if (isHeightmapOnly()) report.add("chunks", "heightmapOnly", 1);
+	if (isUniform()) report.add("chunks", "uniform", 1);
+	else if (heightmap) report.add("chunks", "heightmapBytes", sizeof(Heightmap));
+	report.add("chunks", "blockBytes", blocks.read().byteSize());
+	report.add("chunks", "lightBytes", light.read().byteSize());
+	report.add("chunks", "compressedBytes", compressedBlocks.capacity() + compressedLight.capacity());
+	report.add("chunks", "solidColumnBytes", solidColumns.capacity() * sizeof(uint64_t));
+
+	// built meshes waiting on an upload, capacity beyond size is reserved and never written
+	report.add("mesh", "cpuSizeBytes", meshVertices.size() * sizeof(Vertex));
+	report.add("mesh", "cpuCapacityBytes", meshVertices.capacity() * sizeof(Vertex));
+
+	if (VBO != 0) report.add("gpu", "chunkBuffers", 1);
+	report.add("gpu", "chunkBufferBytes", bufferBytes);
+	report.add("gpu", "chunkMeshBytes", uploadedVertices * sizeof(Vertex));
+}
+
+void Chunk::addFace(vector<Vertex>& vertices, ivec3 coords, int index, Block::BlockType type, uint8_t faceLight) {
+	int start = index * 6;
+
+	for (int i = 0; i < 6; i++) {
+		Vertex vertex = Block::cubeVertices[start + i];
+		vertex.coords += coords;
+		vertex.blockType = type;
+		vertex.face = index;
+		vertex.light = faceLight;
+		vertices.push_back(vertex);
+	}
 }
 
-void Chunk::perlinNoise(float frequency, float amplitude, vector<int>& offsets) {
-	for (int x = 0; x < CHUNK_MAX_X; x++) {
-		for (int z = 0; z < CHUNK_MAX_Z; z++) {
-			vec2 samplePoint = 1.0f / frequency * (vec2(x, z) + vec2(worldx * CHUNK_MAX_X, worldz * CHUNK_MAX_Z));
-
-			// get the four corners
-			long x0 = floor(samplePoint.x);
-			long x1 = x0 + 1;
-			long z0 = floor(samplePoint.y);
-			long z1 = z0 + 1;
-
-			/*	ul   ur
-				 +---+    ^ z
-				 |  |    |
-				 +---+     --> x
-				bl   br  */
-
-			// find the dot product between its displacement between corners and random vectors
-			float bl = glm::dot(samplePoint - vec2(x0, z0), noiseHash(seed, x0, z0));
-			float br = glm::dot(samplePoint - vec2(x1, z0), noiseHash(seed, x1, z0));
-			float ul = glm::dot(samplePoint - vec2(x0, z1), noiseHash(seed, x0, z1));
-			float ur = glm::dot(samplePoint - vec2(x1, z1), noiseHash(seed, x1, z1));
-
-			// compute smooth interpolation factors for x and y
-			float tx = glm::smoothstep(0.0f, 1.0f, glm::fract(samplePoint.x));
-			float ty = glm::smoothstep(0.0f, 1.0f, glm::fract(samplePoint.y));
-			
-			// interpolate between them
-			float blerp = glm::mix(bl, br, tx);
-			float ulerp = glm::mix(ul, ur, tx);
-
-			float bilerp = glm::mix(blerp, ulerp, ty);
-			int heightOffset = bilerp * amplitude;
-			offsets[x + CHUNK_MAX_X * z] += heightOffset;
+void Chunk::generate(const vector<int> & offsets) {
+	PROFILE_SCOPE("Chunk::generate");
+	// go through each (x, z) and set the height, using a baseline height
+	// the blocks are air above each height and grass below, filled in only once something changes them
+	auto heights = std::make_shared<Heightmap>();
+	const int bottom = worldy * CHUNK_MAX_Y;
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		for (int x = 0; x < CHUNK_MAX_X; x++) {
+			int height = std::clamp(HEIGHT_BASELINE + offsets[x + CHUNK_MAX_X * z] - bottom, 0, CHUNK_MAX_Y);
+			heights->heights[x + CHUNK_MAX_X * z] = static_cast<uint8_t>(height);
 		}
 	}
+
+	// chunks wholly above or below the surface share one heightmap
+	const uint8_t first = heights->heights[0];
+	bool uniform = (first == 0 || first == CHUNK_MAX_Y)
+		&& std::all_of(heights->heights.begin(), heights->heights.end(), [first](uint8_t height) { return height == first; });
+	heightmap = uniform ? Heightmap::filledTo(first) : std::move(heights);
 }
 
-vec2 Chunk::noiseHash(uint32_t seed, int x, int z) {
-	// Hash to 32-bit
-	seed ^= static_cast<uint32_t>(x) * 0x9E3779B1u;
-	seed ^= static_cast<uint32_t>(z) * 0x85EBCA77u;
-	seed ^= (seed >> 16);
-	seed *= 0x27D4EB2Du;
-	seed ^= (seed >> 15);
+void Chunk::generate(const Density::Plan & terrain) {
+	PROFILE_SCOPE("Chunk::generateDensity");
+	static_assert(CHUNK_MAX_X % DENSITY_CELL_XZ == 0 && CHUNK_MAX_Z % DENSITY_CELL_XZ == 0 && CHUNK_MAX_Y % DENSITY_CELL_Y == 0,
+		"density cells must tile the chunk");
+
+	const ivec3 step(DENSITY_CELL_XZ, DENSITY_CELL_Y, DENSITY_CELL_XZ);
+	const ivec3 count(CHUNK_MAX_X / step.x + 1, CHUNK_MAX_Y / step.y + 1, CHUNK_MAX_Z / step.z + 1);
+
+	vector<float> samples;
+	terrain.evaluateGrid(ivec3(worldx * CHUNK_MAX_X, worldy * CHUNK_MAX_Y, worldz * CHUNK_MAX_Z), count, step, samples);
+
+	auto sampleAt = [&](int x, int y, int z) {
+		return samples[y + count.y * (x + count.x * z)];
+	};
+
+	// trilinear interpolation between the corners of each cell
+	ChunkBlocks& blocks = this->blocks.write();
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		int cz = z / step.z;
+		float tz = static_cast<float>(z % step.z) / step.z;
 
-	// Convert to [0,1)
-	float normalized = static_cast<float>(seed) / static_cast<float>(UINT32_MAX);
+		for (int x = 0; x < CHUNK_MAX_X; x++) {
+			int cx = x / step.x;
+			float tx = static_cast<float>(x % step.x) / step.x;
 
-	// Map to [0, 2pi)
-	float angle = normalized * 2.0f * glm::pi<float>();
+			for (int y = 0; y < CHUNK_MAX_Y; y++) {
+				int cy = y / step.y;
+				float ty = static_cast<float>(y % step.y) / step.y;
 
-	// Convert to unit vector
-	return glm::vec2(std::cos(angle), std::sin(angle));
-}
\ No newline at end of file
+				float c00 = glm::mix(sampleAt(cx, cy, cz), sampleAt(cx + 1, cy, cz), tx);
+				float c10 = glm::mix(sampleAt(cx, cy + 1, cz), sampleAt(cx + 1, cy + 1, cz), tx);
+				float c01 = glm::mix(sampleAt(cx, cy, cz + 1), sampleAt(cx + 1, cy, cz + 1), tx);
+				float c11 = glm::mix(sampleAt(cx, cy + 1, cz + 1), sampleAt(cx + 1, cy + 1, cz + 1), tx);
+				float density = glm::mix(glm::mix(c00, c10, ty), glm::mix(c01, c11, ty), tz);
+
+				blocks.set(x, y, z, density > 0.0f ? 1 : 0);
+			}
+		}
+	}
+}
@@ -6,6 +6,7 @@
 #include <glm/gtc/constants.hpp>
 
 #include <algorithm> // for fill
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <memory>  // for unique ptr
@@ -15,7 +16,14 @@
 #include <vector>
 
 #include "block.h"
+#include "blockstorage.h"
+#include "cow.h"
+#include "density.h"
+#include "memory.h"
 #include "mesh.h"
+#include "meshcache.h"
+#include "noise.h"
+#include "vecn_hash.hpp"
 
 using std::unordered_map;
 using std::vector;
@@ -26,98 +34,285 @@ using glm::ivec3;
 
 /*
 A representation of a chunk of blocks 
-has a world x, y (assuming no chunks stack on each other)
-contains 16 x 128 x 16 blocks 
+has a world x, y and z, chunks stack into columns WORLD_CHUNKS_Y tall
+contains 32 x 32 x 32 blocks 
 */
 
 static constexpr int CHUNK_MAX_X = 32;
-static constexpr int CHUNK_MAX_Y = 48;
+static constexpr int CHUNK_MAX_Y = 32;
 static constexpr int CHUNK_MAX_Z = 32;
 
-static constexpr int HEIGHT_BASELINE = CHUNK_MAX_Y / 2;
+// every side of a chunk has as many cells as any other, see Mesher::sideCell
+static_assert(CHUNK_MAX_X == CHUNK_MAX_Y && CHUNK_MAX_Y == CHUNK_MAX_Z, "chunks are cubes");
+
+// chunks in a column, from y 0 up to WORLD_HEIGHT, nothing is above or below them
+static constexpr int WORLD_CHUNKS_Y = 8;
+static constexpr int WORLD_HEIGHT = WORLD_CHUNKS_Y * CHUNK_MAX_Y;
+
+// halfway up a section, so flat ground doesn't run along a section border
+static constexpr int HEIGHT_BASELINE = WORLD_HEIGHT / 4 + CHUNK_MAX_Y / 2;
 
 // note: use the inverse of frequency for calculations
 static constexpr int INITIAL_FREQUENCY = 64;
 static constexpr int INITIAL_AMPLITUDE = 32;
+static constexpr int NOISE_OCTAVES = 6;
+
+// sampling stride of each octave, smooth low frequency octaves are sampled on a coarse grid and interpolated
+// --bench noise checks the heights stay close to sampling every column
+inline const vector<int> NOISE_STRIDES = { 4, 4, 2, 2, 1, 1 };
+
+// memory order of a chunk's blocks, see blockstorage.h
+// y major keeps columns contiguous, which is how terrain is generated
+template <int X, int Y, int Z>
+using ChunkLayout = Layout::YMajor<X, Y, Z>;
+
+using ChunkBlocks = BlockStorage<CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z, ChunkLayout>;
+
+// one byte per block, sky light in the high nibble and block light in the low, see light.h
+using ChunkLight = BlockStorage<CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z, ChunkLayout, uint8_t>;
+
+// heightmap terrain, solid up to a height in every column and air above
+// a chunk's blocks and light follow from it until something changes them, see Chunk
+// heights are from the bottom of the chunk, 0 above the ground and CHUNK_MAX_Y under it
+struct Heightmap {
+	static constexpr Block::BlockType BLOCK = 1; //TODO: Replace with different blocks
+
+	// Light::OPEN_SKY, light.h includes this file
+	static constexpr uint8_t SKY_LIGHT = 15 << 4;
+
+	std::array<uint8_t, CHUNK_MAX_X * CHUNK_MAX_Z> heights{};
+
+	inline int height(int x, int z) const {
+		return heights[x + CHUNK_MAX_X * z];
+	}
+
+	inline Block::BlockType get(int x, int y, int z) const {
+		return y < height(x, z) ? BLOCK : 0;
+	}
+
+	// what lighting leaves on terrain nothing else shines into, open sky above the ground and dark in it
+	inline uint8_t light(int x, int y, int z) const {
+		return y < height(x, z) ? 0 : SKY_LIGHT;
+	}
+
+	// one heightmap shared by every chunk of the sky, and one by every chunk underground
+	// height is 0 or CHUNK_MAX_Y
+	static std::shared_ptr<const Heightmap> filledTo(int height);
+};
+
+// density terrain is sampled once per cell and interpolated in between
+static constexpr int DENSITY_CELL_XZ = 4;
+static constexpr int DENSITY_CELL_Y = 8;
 
 class Chunk
 {
 private:
-	vector<Block::BlockType> blocks;
+	// copy on write so other threads can work from snapshots while the main thread edits
+	// either may hold nothing while a heightmap chunk's are still what its heights say
+	CopyOnWrite<ChunkBlocks> blocks;
+	CopyOnWrite<ChunkLight> light;
+
+	// set for heightmap terrain, shared with snapshots and never changed
+	std::shared_ptr<const Heightmap> heightmap;
+
+	bool cold = false;
+
+	// bumped by every block or light change, meshes built from an older version are stale
+	uint64_t version = 0;
 
-	unsigned int VAO, VBO;
+	// created lazily on the first upload so chunks can be generated ahead of rendering
+	unsigned int VAO = 0, VBO = 0;
+	int uploadedVertices = 0;
+	GLsizeiptr bufferBytes = 0; // storage allocated for VBO, meshes are copied into it
 
 	uint32_t seed;
 
-	int worldx, worldz;
+	int worldx, worldy, worldz;
 
 	vector<Vertex> meshVertices;
 
-	void updateMesh();
+	// see getSolidColumns, built from the blocks of version solidColumnsVersion
+	mutable vector<uint64_t> solidColumns;
+	mutable uint64_t solidColumnsVersion = UINT64_MAX;
 
-	void addBlockMesh(ivec3 coords);
+	// run length copies of the blocks and light while the chunk is cold, see freeze
+	vector<uint8_t> compressedBlocks;
+	vector<uint8_t> compressedLight;
 
-	void addFace(ivec3 coords, int index);
+	static void addFace(vector<Vertex>& vertices, ivec3 coords, int index, Block::BlockType type, uint8_t faceLight);
 
-	void generate(int octaves = 1);
+	void generate(const vector<int> & offsets);
 
-	void perlinNoise(float frequency, float amplitude, vector<int> & offsets);
+	void generate(const Density::Plan & terrain);
 
-	vec2 noiseHash(uint32_t seed, int x, int z);
+	// hands the vertex array and buffer back to the pool
+	void releaseBuffers();
+
+	// fill in the storage from the heightmap, before the first change to it
+	void materializeBlocks();
+	void materializeLight();
+
+	// all air or all grass chunks give their storage back and keep a shared heightmap
+	void flattenIfUniform();
 
 public:
-	Chunk(uint32_t seed, int worldx = 0, int worldz = 0);
+	// border faces take their light from the next chunk over and are left out against solid blocks in it
+	// indexed by face like Mesher::FACE_OFFSETS: front (+z), back (-z), left (-x), right (+x), top, bottom, null if not loaded
+	using Neighbours = std::array<const Chunk*, 6>;
+
+	// immutable view of a chunk for other threads, never changed by later edits
+	// blocks and light are null while they follow from the heights, all of them are for cold chunks
+	struct Snapshot {
+		std::shared_ptr<const ChunkBlocks> blocks;
+		std::shared_ptr<const ChunkLight> light;
+		std::shared_ptr<const Heightmap> heights;
+		uint64_t version = 0;
+	};
+
+	// same order as Neighbours
+	using NeighbourSnapshots = std::array<Snapshot, 6>;
+
+	// heights come from the world's shared noise tiles
+	// only the heights are kept, blocks are filled in on the first edit and light on the first change to it
+	Chunk(uint32_t seed, int worldx, int worldy, int worldz, Noise::TileCache & noise);
+
+	// heights already sliced from the noise tiles, so the chunk can be built off the main thread
+	Chunk(uint32_t seed, int worldx, int worldy, int worldz, const vector<int> & offsets);
+
+	// 3D terrain from a compiled density graph
+	Chunk(uint32_t seed, int worldx, int worldy, int worldz, const Density::Plan & terrain);
+
+	// blocks generated elsewhere and sent run length encoded, see ChunkServer
+	Chunk(int worldx, int worldy, int worldz, const vector<uint8_t>& runs);
 
 	~Chunk();
 
 	void draw() const;
 
-	int getBlockIndex(const ivec3 & coords) const {
-		const bool outOfBounds =
-			coords.x < 0 || coords.x >= CHUNK_MAX_X ||
-			coords.y < 0 || coords.y >= CHUNK_MAX_Y ||
-			coords.z < 0 || coords.z >= CHUNK_MAX_Z;
-		if (outOfBounds)
-			return -1;
+	// rebuilds the mesh on the CPU, no GL calls
+	// with a cache, an identical chunk meshed before is read back instead and new meshes are stored
+	void buildMesh(MeshCache* cache = nullptr, const Neighbours& neighbours = {});
+
+	// sends the last built mesh to the GPU
+	void uploadMesh();
+
+	// main thread only, like every other non const method
+	Snapshot snapshot() const;
 
-		return coords.x + CHUNK_MAX_X * (coords.y + CHUNK_MAX_Y * coords.z);
+	// meshes a snapshot without touching the chunk, safe on any thread
+	static vector<Vertex> meshSnapshot(const Snapshot& chunk, const NeighbourSnapshots& neighbours, MeshCache* cache);
+
+	// takes a mesh built from the snapshot with version builtFrom, it is dropped and false returned if the chunk changed since
+	bool acceptMesh(vector<Vertex>&& vertices, uint64_t builtFrom);
+
+	inline uint64_t getVersion() const {
+		return version;
+	}
+
+	inline void updateMesh(const Neighbours& neighbours = {}) {
+		buildMesh(nullptr, neighbours);
+		uploadMesh();
+	}
+
+	// cold chunks keep only a compressed copy of their blocks and no GPU buffers or mesh
+	// they read as air and ignore edits until thawed
+	// a heightmap chunk never edited keeps only its heights
+	void freeze();
+
+	// restores the blocks, the mesh has to be rebuilt and uploaded afterwards
+	void thaw();
+
+	inline bool isCold() const {
+		return cold;
+	}
+
+	// whether the blocks are still only the heightmap
+	inline bool isHeightmapOnly() const {
+		return !blocks.read().isResident() && !cold;
+	}
+
+	// whether the heightmap is one of the shared ones, see Heightmap::filledTo
+	inline bool isUniform() const {
+		return heightmap && (heightmap == Heightmap::filledTo(0) || heightmap == Heightmap::filledTo(CHUNK_MAX_Y));
+	}
+
+	// CPU memory held by the blocks, light and mesh, the uploaded buffer isn't counted
+	inline size_t residentBytes() const {
+		return blocks.read().byteSize() + light.read().byteSize() + compressedBlocks.capacity() + compressedLight.capacity()
+			+ meshVertices.capacity() * sizeof(Vertex) + (heightmap && !isUniform() ? sizeof(Heightmap) : 0);
+	}
+
+	// run length encoded like BlockStorage::compress, built from the heights if need be
+	vector<uint8_t> compressBlocks() const;
+
+	// adds its blocks, light, mesh and GPU buffer to the chunks, mesh and gpu groups
+	void reportMemory(MemoryReport& report) const;
+
+	// bit y of entry x + CHUNK_MAX_X * z is set for every solid block in that column, for collision
+	// rebuilt on the first call after the chunk changed, main thread only and not for cold chunks
+	const vector<uint64_t>& getSolidColumns() const;
+
+	// unchecked, in chunk coords, for the light engine
+	inline Block::BlockType getBlock(const ivec3& coords) const {
+		const ChunkBlocks& storage = blocks.read();
+		return storage.isResident() ? storage.get(coords.x, coords.y, coords.z) : heightmap->get(coords.x, coords.y, coords.z);
+	}
+
+	inline uint8_t getLight(const ivec3& coords) const {
+		const ChunkLight& storage = light.read();
+		return storage.isResident() ? storage.get(coords.x, coords.y, coords.z) : heightmap->light(coords.x, coords.y, coords.z);
+	}
+
+	// lighting a heightmap chunk mostly sets what the heights already say, that doesn't need the storage
+	inline void setLight(const ivec3& coords, uint8_t value) {
+		if (!light.read().isResident()) {
+			if (value == heightmap->light(coords.x, coords.y, coords.z)) return;
+			materializeLight();
+		}
+		light.write().set(coords.x, coords.y, coords.z, value);
+		version++;
+	}
+
+	// -1 when out of bounds
+	int getBlockIndex(const ivec3 & coords) const {
+		return ChunkBlocks::checkedIndex(coords);
 	}
 
 	inline const Block::BlockDef& getBlockDef(ivec3 coords) const {
 		using Block::BlockRegistry;
 		static const Block::BlockDef& airDef = BlockRegistry::getInstance().getDef(0);
 
-		int index = getBlockIndex(coords);
-		if (index == -1) return airDef;
-
-		Block::BlockType type = blocks[index];
+		if (getBlockIndex(coords) == -1 || isCold()) return airDef;
 
-		return BlockRegistry::getInstance().getDef(type);
+		return BlockRegistry::getInstance().getDef(getBlock(coords));
 	}
 
+	// edits only change the block, the world relights and remeshes around it
 	inline bool removeBlock(ivec3 coords) {
 		int index = getBlockIndex(coords);
-		if (index == -1) return false;
+		if (index == -1 || isCold()) return false;
 
-		blocks[index] = 0;
-
-		updateMesh();
+		if (!blocks.read().isResident()) materializeBlocks();
+		blocks.write()[index] = 0;
+		version++;
 
 		return true;
 	}
 
 	inline Block::BlockType placeBlock(ivec3 coords, Block::BlockType type) {
 		int index = getBlockIndex(coords);
-		if (index == -1) return 0;
-
-		blocks[index] = type;
+		if (index == -1 || isCold()) return 0;
 
-		updateMesh();
+		if (!blocks.read().isResident()) materializeBlocks();
+		blocks.write()[index] = type;
+		version++;
 
 		return type;
 	}
 
 	inline ivec3 getModelCoords() const {
-		return ivec3(worldx, 0, worldz);
+		return ivec3(worldx, worldy, worldz);
 	}
-};
\ No newline at end of file
+};
+
+using ChunkMap = unordered_map<ivec3, std::unique_ptr<Chunk>, vec3Hash>;
\ No newline at end of file
@@ -0,0 +1,146 @@
+#include "chunkpool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+template <typename T>
+T ChunkPool::take(FreeList<T>& list) {
+	list.taken++;
+	if (list.items.empty()) return T();
+
+	T item = std::move(list.items.back());
+	list.items.pop_back();
+	list.reused++;
+	return item;
+}
+
+template <typename T>
+bool ChunkPool::give(FreeList<T>& list, T& item, size_t capacity) {
+	if (list.items.size() >= capacity) {
+		list.dropped++;
+		return false;
+	}
+	list.items.push_back(std::move(item));
+	return true;
+}
+
+void ChunkPool::setCapacity(size_t slots) {
+	// shrinking frees the surplus straight away
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		capacity = slots;
+		blocks.items.resize(std::min(blocks.items.size(), capacity));
+		light.items.resize(std::min(light.items.size(), capacity));
+		meshes.items.resize(std::min(meshes.items.size(), std::min(capacity, MESH_POOL_SLOTS)));
+	}
+	while (buffers.items.size() > capacity) {
+		Buffers surplus = take(buffers);
+		glDeleteVertexArrays(1, &surplus.VAO);
+		glDeleteBuffers(1, &surplus.VBO);
+	}
+}
+
+vector<Block::BlockType> ChunkPool::takeBlocks() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return take(blocks);
+}
+
+void ChunkPool::giveBlocks(vector<Block::BlockType>&& storage) {
+	std::lock_guard<std::mutex> lock(mutex);
+	give(blocks, storage, capacity);
+}
+
+vector<uint8_t> ChunkPool::takeLight() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return take(light);
+}
+
+void ChunkPool::giveLight(vector<uint8_t>&& storage) {
+	std::lock_guard<std::mutex> lock(mutex);
+	give(light, storage, capacity);
+}
+
+vector<Vertex> ChunkPool::takeMesh() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return take(meshes);
+}
+
+void ChunkPool::giveMesh(vector<Vertex>&& vertices) {
+	// an empty vector has nothing worth keeping
+	if (vertices.capacity() == 0) return;
+	vertices.clear();
+
+	std::lock_guard<std::mutex> lock(mutex);
+	give(meshes, vertices, std::min(capacity, MESH_POOL_SLOTS));
+}
+
+ChunkPool::Buffers ChunkPool::takeBuffers() {
+	Buffers taken = take(buffers);
+	if (taken.VAO != 0) return taken;
+
+	glGenVertexArrays(1, &taken.VAO);
+	glGenBuffers(1, &taken.VBO);
+
+	glBindVertexArray(taken.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, taken.VBO);
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+	glEnableVertexAttribArray(1);
+
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+	glEnableVertexAttribArray(2);
+
+	// block type, face and light together, as integers
+	glVertexAttribIPointer(3, 3, GL_UNSIGNED_BYTE, sizeof(Vertex), (void*)offsetof(Vertex, blockType));
+	glEnableVertexAttribArray(3);
+
+	return taken;
+}
+
+void ChunkPool::giveBuffers(Buffers given) {
+	if (given.VAO == 0) return;
+	if (give(buffers, given, capacity)) return;
+
+	glDeleteVertexArrays(1, &given.VAO);
+	glDeleteBuffers(1, &given.VBO);
+}
+
+uint64_t ChunkPool::allocations() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return blocks.taken - blocks.reused + light.taken - light.reused + meshes.taken - meshes.reused + buffers.taken - buffers.reused;
+}
+
+uint64_t ChunkPool::frees() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return blocks.dropped + light.dropped + meshes.dropped + buffers.dropped;
+}
+
+void ChunkPool::printStats(std::ostream& os) const {
+	auto print = [&os](const char* name, const auto& list) {
+		os << " " << name << " " << list.reused << "/" << list.taken << " reused, " << list.dropped << " freed,";
+	};
+
+	std::lock_guard<std::mutex> lock(mutex);
+	os << "Chunk pool:";
+	print("blocks", blocks);
+	print("light", light);
+	print("meshes", meshes);
+	print("buffers", buffers);
+	os << " " << capacity << " slots\n";
+}
+
+void ChunkPool::reportMemory(MemoryReport& report) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	report.add("pool", "blockStorages", blocks.items.size());
+	for (const auto& storage : blocks.items) report.add("pool", "blockBytes", storage.capacity() * sizeof(Block::BlockType));
+	report.add("pool", "lightStorages", light.items.size());
+	for (const auto& storage : light.items) report.add("pool", "lightBytes", storage.capacity());
+	report.add("pool", "meshes", meshes.items.size());
+	for (const auto& vertices : meshes.items) report.add("pool", "meshBytes", vertices.capacity() * sizeof(Vertex));
+	report.add("pool", "buffers", buffers.items.size());
+	for (const Buffers& pooled : buffers.items) report.add("pool", "bufferBytes", pooled.bytes);
+}
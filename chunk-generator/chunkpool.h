@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "block.h"
+#include "memory.h"
+#include "mesh.h"
+
+using std::vector;
+
+// built meshes only live until they are uploaded, so few are ever waiting to be reused
+// fewer are kept if the pool's capacity is lower
+static constexpr size_t MESH_POOL_SLOTS = 8;
+
+/*
+Recycles what chunks let go of, so loading and thawing reuse it instead of allocating
+Block and light storage come back when a chunk freezes, mesh vectors once they are uploaded and
+vertex arrays with their buffers when a chunk freezes or is destroyed. Buffers keep their storage
+and vertex format, so a reused one only needs glBufferData if the new mesh is bigger.
+Anything given back past the capacity is freed as before
+Storage and mesh vectors may be taken and given from any thread, buffers only on the main thread
+*/
+class ChunkPool // Singleton
+{
+public:
+	// a vertex array bound to its buffer with the chunk vertex format set up
+	struct Buffers {
+		GLuint VAO = 0, VBO = 0;
+		GLsizeiptr bytes = 0; // storage the buffer already has
+	};
+
+	static ChunkPool& getInstance() {
+		static ChunkPool instance;
+		return instance;
+	}
+
+	// how many block storages, light storages and buffers are kept, World sets it from the render distance
+	void setCapacity(size_t slots);
+
+	// empty, with the capacity of an earlier chunk's when there was one to reuse
+	vector<Block::BlockType> takeBlocks();
+	void giveBlocks(vector<Block::BlockType>&& storage);
+
+	vector<uint8_t> takeLight();
+	void giveLight(vector<uint8_t>&& storage);
+
+	vector<Vertex> takeMesh();
+	void giveMesh(vector<Vertex>&& vertices);
+
+	// creates them if none are pooled, needs a current GL context
+	Buffers takeBuffers();
+	void giveBuffers(Buffers buffers);
+
+	// takes the pool couldn't serve and gives it couldn't keep, of every kind together
+	uint64_t allocations() const;
+	uint64_t frees() const;
+
+	void printStats(std::ostream& os) const;
+
+	void reportMemory(MemoryReport& report) const;
+
+private:
+	// things given back and waiting to be taken, with how often that worked out
+	template <typename T>
+	struct FreeList {
+		vector<T> items;
+		uint64_t taken = 0;
+		uint64_t reused = 0; // takes served from items
+		uint64_t dropped = 0; // gives past the capacity
+	};
+
+	mutable std::mutex mutex; // guards everything but buffers
+	size_t capacity = 0;
+
+	FreeList<vector<Block::BlockType>> blocks;
+	FreeList<vector<uint8_t>> light;
+	FreeList<vector<Vertex>> meshes;
+	FreeList<Buffers> buffers;
+
+	ChunkPool() = default;
+
+	template <typename T>
+	static T take(FreeList<T>& list);
+
+	// false if the list was full, the item is left alone
+	template <typename T>
+	static bool give(FreeList<T>& list, T& item, size_t capacity);
+};
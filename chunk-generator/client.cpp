@@ -0,0 +1,116 @@
+#include "client.h"
+
+#include "chunk.h"
+
+namespace {
+	// a chunk whose runs don't cover it exactly would read past its blocks
+	bool coversChunk(const vector<uint8_t>& runs) {
+		size_t blocks = 0;
+		for (size_t i = 0; i + 1 < runs.size(); i += 2) blocks += runs[i];
+		return runs.size() % 2 == 0 && blocks == ChunkBlocks::Layout::volume;
+	}
+}
+
+void ChunkClient::subscribe(ivec3 center, int radius, int verticalRadius) {
+	if (subscription && subscription->center == center && subscription->radius == radius
+		&& subscription->verticalRadius == verticalRadius) return;
+	subscription = Protocol::Subscribe{ center, radius, verticalRadius };
+	connection.send(Net::MessageType::SUBSCRIBE, subscription->encode());
+}
+
+void ChunkClient::edit(ivec3 worldPosition, Block::BlockType type) {
+	connection.send(Net::MessageType::EDIT, Protocol::Edit{ worldPosition, type }.encode());
+	// a position edited again is timed from the latest edit, its delta answers that one
+	pendingEdits[worldPosition] = std::chrono::steady_clock::now();
+}
+
+bool ChunkClient::poll(int timeoutMillis) {
+	PROFILE_SCOPE("ChunkClient::poll");
+	connection.flush();
+
+	if (queuedChunks >= MAX_QUEUED_CHUNKS) {
+		stats.stalls++;
+		return connection.isOpen();
+	}
+
+	if (timeoutMillis > 0) Net::wait({ { connection.handle(), connection.pendingBytes() > 0 } }, timeoutMillis);
+	connection.receive();
+	while (queuedChunks < MAX_QUEUED_CHUNKS) {
+		std::optional<Net::Message> message = connection.next();
+		if (!message) break;
+		handle(std::move(*message));
+	}
+	expireEdits();
+	return connection.isOpen();
+}
+
+void ChunkClient::handle(Net::Message&& message) {
+	Update update;
+	update.type = message.type;
+
+	if (message.type == Net::MessageType::CHUNK) {
+		std::optional<Protocol::ChunkData> chunk = Protocol::ChunkData::decode(message.payload);
+		if (!chunk || !coversChunk(chunk->blocks)) {
+			std::cout << "ERR :: MALFORMED CHUNK FROM SERVER" << std::endl;
+			return;
+		}
+		update.chunk = std::move(*chunk);
+		stats.chunksReceived++;
+		stats.chunkBytes += message.payload.size();
+		queuedChunks++;
+	}
+	else if (message.type == Net::MessageType::DELTA) {
+		std::optional<Protocol::Delta> delta = Protocol::Delta::decode(message.payload);
+		if (!delta) {
+			std::cout << "ERR :: MALFORMED DELTA FROM SERVER" << std::endl;
+			return;
+		}
+		update.delta = std::move(*delta);
+		stats.deltasReceived++;
+		stats.deltaBytes += message.payload.size();
+
+		const auto now = std::chrono::steady_clock::now();
+		for (const Protocol::Delta::Change& change : update.delta.changes) {
+			ivec3 worldPosition = change.coords + update.delta.coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+			auto sent = pendingEdits.find(worldPosition);
+			if (sent == pendingEdits.end()) continue;
+			editLatency.add(std::chrono::duration_cast<std::chrono::microseconds>(now - sent->second).count());
+			pendingEdits.erase(sent);
+		}
+	}
+	else {
+		std::cout << "ERR :: UNEXPECTED MESSAGE " << static_cast<int>(message.type) << " FROM SERVER" << std::endl;
+		return;
+	}
+
+	updates.push_back(std::move(update));
+}
+
+void ChunkClient::expireEdits() {
+	const auto oldest = std::chrono::steady_clock::now() - std::chrono::milliseconds(EDIT_TIMEOUT_MILLIS);
+	for (auto it = pendingEdits.begin(); it != pendingEdits.end();) {
+		if (it->second < oldest) {
+			it = pendingEdits.erase(it);
+			stats.editsUnanswered++;
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+ChunkClient::Update ChunkClient::takeUpdate() {
+	Update update = std::move(updates.front());
+	updates.pop_front();
+	if (update.type == Net::MessageType::CHUNK) queuedChunks--;
+	return update;
+}
+
+void ChunkClient::printStats(std::ostream& os) const {
+	os << "Client: " << stats.chunksReceived << " chunks, "
+		<< (stats.chunksReceived ? stats.chunkBytes / stats.chunksReceived : 0) << " bytes per chunk, "
+		<< stats.deltasReceived << " deltas, " << (stats.deltasReceived ? stats.deltaBytes / stats.deltasReceived : 0) << " bytes per delta, "
+		<< connection.bytesReceived / 1024 << "KB received, " << stats.stalls << " polls held back by a full queue\n";
+	os << "Edit round trip: " << editLatency.count << " edits, " << editLatency.averageMillis() << "ms avg, "
+		<< editLatency.maxMillis() << "ms max, " << stats.editsUnanswered << " unanswered\n";
+}
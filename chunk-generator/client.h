@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+#include "net.h"
+#include "profiler.h"
+#include "protocol.h"
+#include "vecn_hash.hpp"
+
+using glm::ivec3;
+
+// received chunks waiting on the world past this stop the client reading,
+// so a slow client pushes back on the server instead of buffering without limit
+static constexpr size_t MAX_QUEUED_CHUNKS = 64;
+
+// the server sends nothing back for an edit it rejected or that changed nothing,
+// edits still unanswered after this are dropped so a later delta can't count them
+static constexpr int EDIT_TIMEOUT_MILLIS = 2000;
+
+/*
+Render half of a split world, talks to a ChunkServer
+Chunks and deltas are queued in the order they arrived, so a delta never overtakes
+the chunk it applies to. Edits go to the server and only show up once its delta comes back
+*/
+class ChunkClient
+{
+public:
+	// one CHUNK or DELTA message, only the matching member is filled
+	struct Update {
+		Net::MessageType type;
+		Protocol::ChunkData chunk;
+		Protocol::Delta delta;
+	};
+
+	explicit ChunkClient(Net::Connection connection) : connection(std::move(connection)) {}
+
+	// asks for the box of chunks around center, only sent when it changed
+	void subscribe(ivec3 center, int radius, int verticalRadius);
+
+	// air removes
+	void edit(ivec3 worldPosition, Block::BlockType type);
+
+	// sends what is queued and reads what has arrived, waiting up to timeoutMillis for it
+	// false once the server is gone
+	bool poll(int timeoutMillis = 0);
+
+	inline bool hasUpdate() const {
+		return !updates.empty();
+	}
+
+	inline bool nextIsChunk() const {
+		return !updates.empty() && updates.front().type == Net::MessageType::CHUNK;
+	}
+
+	Update takeUpdate();
+
+	inline bool isConnected() const {
+		return connection.isOpen();
+	}
+
+	// edit sent to its delta received
+	inline const LatencyStats& getEditLatency() const {
+		return editLatency;
+	}
+
+	inline uint64_t getChunksReceived() const {
+		return stats.chunksReceived;
+	}
+
+	inline uint64_t getBytesReceived() const {
+		return connection.bytesReceived;
+	}
+
+	void printStats(std::ostream& os) const;
+
+private:
+	Net::Connection connection;
+	std::optional<Protocol::Subscribe> subscription;
+
+	std::deque<Update> updates;
+	size_t queuedChunks = 0;
+
+	// when each edit still waiting on its delta was sent
+	std::unordered_map<ivec3, std::chrono::steady_clock::time_point, vec3Hash> pendingEdits;
+	LatencyStats editLatency;
+
+	struct Stats {
+		uint64_t chunksReceived = 0;
+		uint64_t chunkBytes = 0; // payloads only, before framing
+		uint64_t deltasReceived = 0;
+		uint64_t deltaBytes = 0;
+		uint64_t stalls = 0; // polls that left data unread because the queue was full
+		uint64_t editsUnanswered = 0; // dropped after EDIT_TIMEOUT_MILLIS
+	} stats;
+
+	void handle(Net::Message&& message);
+	void expireEdits();
+};
@@ -0,0 +1,164 @@
+#include "collision.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+
+namespace Collision {
+	namespace {
+		// how close a box may be to a cell before it counts as inside it, so resting on a face isn't a collision
+		constexpr float EPSILON = 1e-4f;
+
+		constexpr uint64_t SOLID_COLUMN = CHUNK_MAX_Y == 64 ? ~uint64_t(0) : (uint64_t(1) << CHUNK_MAX_Y) - 1;
+
+		// the chunks of a column a range of y passes through, kept inside the world
+		inline int firstLayer(int minY) {
+			return std::clamp(Noise::floorDiv(minY, CHUNK_MAX_Y), 0, WORLD_CHUNKS_Y - 1);
+		}
+
+		inline int lastLayer(int maxY) {
+			return std::clamp(Noise::floorDiv(maxY, CHUNK_MAX_Y), 0, WORLD_CHUNKS_Y - 1);
+		}
+
+		// blocks are centred on integer coords, shifted by half a block every cell c spans [c, c + 1)
+		inline int firstCell(float min) {
+			return static_cast<int>(std::floor(min + 0.5f + EPSILON));
+		}
+
+		inline int lastCell(float max) {
+			return static_cast<int>(std::ceil(max + 0.5f - EPSILON)) - 1;
+		}
+	}
+
+	void Occupancy::gather(const ChunkMap& chunks, ivec3 min, ivec3 max) {
+		origin = ivec3(min.x, firstLayer(min.y), min.z);
+		width = max.x - min.x + 1;
+		depth = max.z - min.z + 1;
+		const int layers = lastLayer(max.y) - origin.y + 1;
+		columns.resize(width * depth * layers);
+
+		const int firstChunkX = Noise::floorDiv(min.x, CHUNK_MAX_X), lastChunkX = Noise::floorDiv(max.x, CHUNK_MAX_X);
+		const int firstChunkZ = Noise::floorDiv(min.z, CHUNK_MAX_Z), lastChunkZ = Noise::floorDiv(max.z, CHUNK_MAX_Z);
+
+		for (int layer = 0; layer < layers; layer++) {
+			for (int chunkZ = firstChunkZ; chunkZ <= lastChunkZ; chunkZ++) {
+				for (int chunkX = firstChunkX; chunkX <= lastChunkX; chunkX++) {
+					auto it = chunks.find(ivec3(chunkX, origin.y + layer, chunkZ));
+					const Chunk* chunk = it != chunks.end() && !it->second->isCold() ? it->second.get() : nullptr;
+					const vector<uint64_t>* solid = chunk ? &chunk->getSolidColumns() : nullptr;
+
+					// the part of the box inside this chunk, in world columns
+					const int fromX = std::max(min.x, chunkX * CHUNK_MAX_X), toX = std::min(max.x, chunkX * CHUNK_MAX_X + CHUNK_MAX_X - 1);
+					const int fromZ = std::max(min.z, chunkZ * CHUNK_MAX_Z), toZ = std::min(max.z, chunkZ * CHUNK_MAX_Z + CHUNK_MAX_Z - 1);
+
+					for (int z = fromZ; z <= toZ; z++) {
+						uint64_t* out = &columns[(fromX - origin.x) + width * ((z - origin.z) + depth * layer)];
+						if (!solid) {
+							std::fill(out, out + (toX - fromX + 1), SOLID_COLUMN);
+							continue;
+						}
+
+						const uint64_t* in = &(*solid)[(fromX - chunkX * CHUNK_MAX_X) + CHUNK_MAX_X * (z - chunkZ * CHUNK_MAX_Z)];
+						std::copy(in, in + (toX - fromX + 1), out);
+					}
+				}
+			}
+		}
+	}
+
+	bool Occupancy::anySolid(ivec3 min, ivec3 max) const {
+		if (min.y < 0) return true;
+		max.y = std::min(max.y, WORLD_HEIGHT - 1);
+		if (min.y > max.y) return false;
+
+		for (int layer = firstLayer(min.y); layer <= lastLayer(max.y); layer++) {
+			// the cells of the range inside this layer's chunks
+			const int bottom = layer * CHUNK_MAX_Y;
+			const int from = std::max(min.y, bottom) - bottom, to = std::min(max.y, bottom + CHUNK_MAX_Y - 1) - bottom;
+			const int height = to - from + 1;
+			const uint64_t mask = (height == 64 ? ~uint64_t(0) : (uint64_t(1) << height) - 1) << from;
+
+			const uint64_t* plane = &columns[width * depth * (layer - origin.y)];
+			for (int z = min.z; z <= max.z; z++) {
+				const uint64_t* row = &plane[width * (z - origin.z)];
+				for (int x = min.x - origin.x; x <= max.x - origin.x; x++) {
+					if (row[x] & mask) return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	vec3 sweep(const Occupancy& occupancy, AABB& box, vec3 delta, bvec3& blocked) {
+		blocked = bvec3(false);
+
+		// y first, so walking into a slope lands on it rather than stopping against its side
+		for (int axis : { 1, 0, 2 }) {
+			float& d = delta[axis];
+			if (d == 0.0f) continue;
+
+			// the cells the box covers, the swept axis is overwritten per layer
+			ivec3 min(firstCell(box.min.x), firstCell(box.min.y), firstCell(box.min.z));
+			ivec3 max(lastCell(box.max.x), lastCell(box.max.y), lastCell(box.max.z));
+
+			if (d > 0.0f) {
+				const int last = lastCell(box.max[axis] + d);
+				for (int layer = max[axis] + 1; layer <= last; layer++) {
+					min[axis] = max[axis] = layer;
+					if (occupancy.anySolid(min, max)) {
+						d = std::max(0.0f, layer - 0.5f - box.max[axis]);
+						blocked[axis] = true;
+						break;
+					}
+				}
+			}
+			else {
+				const int last = firstCell(box.min[axis] + d);
+				for (int layer = min[axis] - 1; layer >= last; layer--) {
+					min[axis] = max[axis] = layer;
+					if (occupancy.anySolid(min, max)) {
+						d = std::min(0.0f, layer + 0.5f - box.min[axis]);
+						blocked[axis] = true;
+						break;
+					}
+				}
+			}
+
+			box.min[axis] += d;
+			box.max[axis] += d;
+		}
+
+		return delta;
+	}
+
+	namespace {
+		// every cell the box touches before and after moving by delta
+		inline void gatherFor(const ChunkMap& chunks, const AABB& box, vec3 delta, Occupancy& occupancy) {
+			vec3 min = glm::min(box.min, box.min + delta);
+			vec3 max = glm::max(box.max, box.max + delta);
+			occupancy.gather(chunks, ivec3(firstCell(min.x), firstCell(min.y), firstCell(min.z)), ivec3(lastCell(max.x), lastCell(max.y), lastCell(max.z)));
+		}
+	}
+
+	void moveBodies(const ChunkMap& chunks, vector<Body>& bodies, float seconds) {
+		PROFILE_SCOPE("Collision::moveBodies");
+		Occupancy occupancy;
+		for (Body& body : bodies) {
+			vec3 delta = body.velocity * seconds;
+			gatherFor(chunks, body.box, delta, occupancy);
+			sweep(occupancy, body.box, delta, body.blocked);
+
+			// blocked bodies come to a stop along that axis instead of pressing into the block
+			for (int axis = 0; axis < 3; axis++) {
+				if (body.blocked[axis]) body.velocity[axis] = 0.0f;
+			}
+		}
+	}
+
+	vec3 move(const ChunkMap& chunks, AABB& box, vec3 delta, bvec3& blocked) {
+		Occupancy occupancy;
+		gatherFor(chunks, box, delta, occupancy);
+		return sweep(occupancy, box, delta, blocked);
+	}
+}
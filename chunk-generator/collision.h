@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "chunk.h"
+
+using std::vector;
+
+using glm::bvec3;
+using glm::ivec3;
+using glm::vec3;
+
+/*
+Boxes moving through the voxel grid without passing into solid blocks
+A move first copies the solid masks of every column the box could sweep through out of the
+chunks, one mask per chunk a column passes through, then slides along y, x and z in turn, stopping each axis at the first layer of cells
+with anything solid in it. Checking a layer is a few mask tests per column, never a block lookup.
+Blocks are unit cubes centred on their integer coordinates, like the meshes
+*/
+namespace Collision {
+	struct AABB {
+		vec3 min, max;
+	};
+
+	// something that moves and collides, velocity in blocks per second
+	struct Body {
+		AABB box;
+		vec3 velocity{ 0.0f };
+		bvec3 blocked{ false }; // axes stopped by a block on the last move
+	};
+
+	// the solid masks of a box of cells, below the world counts as solid and above it as empty
+	// chunks that aren't loaded or are cold count as solid, so nothing falls out of the world before it loads
+	class Occupancy {
+	public:
+		// cells min to max inclusive, in world block coords, gathered a whole chunk tall at a time
+		void gather(const ChunkMap& chunks, ivec3 min, ivec3 max);
+
+		// true if any cell from min to max inclusive is solid, all inside the gathered cells
+		bool anySolid(ivec3 min, ivec3 max) const;
+
+	private:
+		ivec3 origin{ 0 }; // x and z in world block coords, y the chunk of the first layer
+		int width = 0, depth = 0;
+		vector<uint64_t> columns; // indexed x + width * (z + depth * layer) relative to origin
+	};
+
+	// moves box by up to delta, stopping at solid blocks, and returns how far it actually moved
+	// occupancy must cover the box before and after the full delta
+	vec3 sweep(const Occupancy& occupancy, AABB& box, vec3 delta, bvec3& blocked);
+
+	// moves every body by its velocity for seconds, reusing one gather buffer for all of them
+	void moveBodies(const ChunkMap& chunks, vector<Body>& bodies, float seconds);
+
+	// moves one box, gathering just the columns it needs
+	vec3 move(const ChunkMap& chunks, AABB& box, vec3 delta, bvec3& blocked);
+}
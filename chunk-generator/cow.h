@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+/*
+Copy on write ownership of a value that other threads only ever read
+The owner reads and writes in place. Readers hold immutable snapshots that stay valid for
+as long as they are kept, and the owner copies the value before writing while any snapshot
+is still alive, so neither side ever waits on the other.
+Only the owning thread may call write or snapshot, snapshots can be read from any thread
+*/
+template <typename T>
+class CopyOnWrite
+{
+public:
+	template <typename... Args>
+	explicit CopyOnWrite(Args&&... args) : data(std::make_shared<T>(std::forward<Args>(args)...)) {}
+
+	inline const T& read() const {
+		return *data;
+	}
+
+	// a reader dropping its snapshot concurrently only means one copy more than needed
+	inline T& write() {
+		if (data.use_count() > 1) {
+			data = std::make_shared<T>(*data);
+			copies.fetch_add(1, std::memory_order_relaxed);
+		}
+		return *data;
+	}
+
+	inline std::shared_ptr<const T> snapshot() const {
+		return data;
+	}
+
+	// how many writes had to copy because a snapshot was alive, across every holder of T
+	static inline std::atomic<uint64_t> copies{ 0 };
+
+private:
+	std::shared_ptr<T> data;
+};
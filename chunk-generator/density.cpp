@@ -0,0 +1,267 @@
+#include "density.h"
+
+#include <algorithm>
+
+namespace Density {
+	namespace {
+		float splineValue(const vector<vec2>& points, float x) {
+			if (points.empty()) return x;
+			if (x <= points.front().x) return points.front().y;
+			if (x >= points.back().x) return points.back().y;
+
+			auto upper = std::upper_bound(points.begin(), points.end(), x,
+				[](float value, const vec2& point) { return value < point.x; });
+			const vec2& high = *upper;
+			const vec2& low = *(upper - 1);
+			return glm::mix(low.y, high.y, (x - low.x) / (high.x - low.x));
+		}
+
+		// the ops that only combine their inputs, shared by both stages and by constant folding
+		bool runElementwise(Op op, const float* params, const vector<vec2>& points,
+			float* dst, const float* a, const float* b, int n) {
+			switch (op) {
+				case Op::Constant:
+					std::fill(dst, dst + n, params[0]);
+					return true;
+				case Op::Add:
+					for (int i = 0; i < n; i++) dst[i] = a[i] + b[i];
+					return true;
+				case Op::Mul:
+					for (int i = 0; i < n; i++) dst[i] = a[i] * b[i];
+					return true;
+				case Op::Clamp:
+					for (int i = 0; i < n; i++) dst[i] = std::min(std::max(a[i], params[0]), params[1]);
+					return true;
+				case Op::Spline:
+					for (int i = 0; i < n; i++) dst[i] = splineValue(points, a[i]);
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		bool isFoldable(Op op) {
+			return op == Op::Add || op == Op::Mul || op == Op::Clamp || op == Op::Spline;
+		}
+	}
+
+	int Graph::push(Node node) {
+		nodes.push_back(std::move(node));
+		return static_cast<int>(nodes.size()) - 1;
+	}
+
+	int Graph::constant(float value) {
+		Node node{ Op::Constant };
+		node.params[0] = value;
+		return push(node);
+	}
+
+	int Graph::noise2D(float frequency, float amplitude, int octaves, uint32_t seed) {
+		Node node{ Op::Noise2D };
+		node.params[0] = frequency;
+		node.params[1] = amplitude;
+		node.octaves = octaves;
+		node.seed = seed;
+		return push(node);
+	}
+
+	int Graph::noise3D(float frequency, float amplitude, int octaves, uint32_t seed) {
+		Node node{ Op::Noise3D };
+		node.params[0] = frequency;
+		node.params[1] = amplitude;
+		node.octaves = octaves;
+		node.seed = seed;
+		return push(node);
+	}
+
+	int Graph::yGradient(float fromY, float fromValue, float toY, float toValue) {
+		Node node{ Op::YGradient };
+		node.params[0] = fromY;
+		node.params[1] = fromValue;
+		node.params[2] = (toValue - fromValue) / (toY - fromY); // slope
+		return push(node);
+	}
+
+	int Graph::add(int a, int b) {
+		Node node{ Op::Add };
+		node.a = a;
+		node.b = b;
+		return push(node);
+	}
+
+	int Graph::mul(int a, int b) {
+		Node node{ Op::Mul };
+		node.a = a;
+		node.b = b;
+		return push(node);
+	}
+
+	int Graph::clamp(int a, float low, float high) {
+		Node node{ Op::Clamp };
+		node.a = a;
+		node.params[0] = low;
+		node.params[1] = high;
+		return push(node);
+	}
+
+	int Graph::spline(int a, vector<vec2> points) {
+		Node node{ Op::Spline };
+		node.a = a;
+		std::sort(points.begin(), points.end(), [](const vec2& l, const vec2& r) { return l.x < r.x; });
+		node.points = std::move(points);
+		return push(node);
+	}
+
+	Plan Graph::compile(int output, uint32_t worldSeed) const {
+		// nodes only ever reference earlier nodes, so index order is already an evaluation order
+		const int count = output + 1;
+
+		vector<bool> used(count, false);
+		used[output] = true;
+		for (int i = output; i >= 0; i--) {
+			if (!used[i]) continue;
+			if (nodes[i].a >= 0) used[nodes[i].a] = true;
+			if (nodes[i].b >= 0) used[nodes[i].b] = true;
+		}
+
+		vector<Node> folded(nodes.begin(), nodes.begin() + count);
+		vector<bool> perSample(count, false);
+		for (int i = 0; i < count; i++) {
+			if (!used[i]) continue;
+			Node& node = folded[i];
+
+			bool constantA = node.a < 0 || folded[node.a].op == Op::Constant;
+			bool constantB = node.b < 0 || folded[node.b].op == Op::Constant;
+			if (isFoldable(node.op) && constantA && constantB) {
+				float a = node.a < 0 ? 0.0f : folded[node.a].params[0];
+				float b = node.b < 0 ? 0.0f : folded[node.b].params[0];
+				float value;
+				runElementwise(node.op, node.params, node.points, &value, &a, &b, 1);
+
+				node = Node{ Op::Constant };
+				node.params[0] = value;
+			}
+
+			perSample[i] = node.op == Op::Noise3D || node.op == Op::YGradient
+				|| (node.a >= 0 && perSample[node.a])
+				|| (node.b >= 0 && perSample[node.b]);
+		}
+
+		Plan plan;
+		vector<int> registers(count, -1);
+		vector<int> broadcasts(count, -1);
+
+		auto toInstruction = [&](const Node& node, int dst, int a, int b) {
+			Plan::Instruction instruction{ node.op, dst, a, b, {}, worldSeed ^ (node.seed * 0x9E3779B9u), node.octaves, node.points };
+			std::copy(node.params, node.params + 4, instruction.params);
+			return instruction;
+		};
+
+		// per sample instructions read per column inputs through a broadcast copy
+		auto sampleInput = [&](int node) {
+			if (node < 0 || perSample[node]) return node < 0 ? -1 : registers[node];
+			if (broadcasts[node] < 0) {
+				broadcasts[node] = plan.sampleRegisters++;
+				plan.sampleStage.push_back(toInstruction(Node{ Op::Broadcast }, broadcasts[node], registers[node], -1));
+			}
+			return broadcasts[node];
+		};
+
+		for (int i = 0; i < count; i++) {
+			if (!used[i]) continue;
+			const Node& node = folded[i];
+
+			if (perSample[i]) {
+				int a = sampleInput(node.a);
+				int b = sampleInput(node.b);
+				registers[i] = plan.sampleRegisters++;
+				plan.sampleStage.push_back(toInstruction(node, registers[i], a, b));
+			}
+			else {
+				int a = node.a < 0 ? -1 : registers[node.a];
+				int b = node.b < 0 ? -1 : registers[node.b];
+				registers[i] = plan.columnRegisters++;
+				plan.columnStage.push_back(toInstruction(node, registers[i], a, b));
+			}
+		}
+
+		plan.output = sampleInput(output);
+		return plan;
+	}
+
+	void Plan::evaluateGrid(ivec3 origin, ivec3 count, ivec3 step, vector<float>& out) const {
+		const int columns = count.x * count.z;
+		const int samples = columns * count.y;
+
+		vector<float> columnValues(static_cast<size_t>(columnRegisters) * columns);
+		vector<float> sampleValues(static_cast<size_t>(sampleRegisters) * samples);
+
+		auto column = [&](int reg) { return reg < 0 ? nullptr : &columnValues[static_cast<size_t>(reg) * columns]; };
+		auto sample = [&](int reg) { return reg < 0 ? nullptr : &sampleValues[static_cast<size_t>(reg) * samples]; };
+
+		for (const Instruction& instruction : columnStage) {
+			float* dst = column(instruction.dst);
+			if (runElementwise(instruction.op, instruction.params, instruction.points, dst, column(instruction.a), column(instruction.b), columns))
+				continue;
+
+			// only Noise2D is left that doesn't depend on y
+			std::fill(dst, dst + columns, 0.0f);
+			float frequency = instruction.params[0];
+			float amplitude = instruction.params[1];
+			for (int octave = 0; octave < instruction.octaves; octave++) {
+				const float scale = 1.0f / frequency;
+				for (int i = 0; i < columns; i++) {
+					float x = static_cast<float>(origin.x + (i % count.x) * step.x);
+					float z = static_cast<float>(origin.z + (i / count.x) * step.z);
+					dst[i] += amplitude * Noise::sample2D(instruction.seed, x * scale, z * scale);
+				}
+				frequency /= 2;
+				amplitude /= 2;
+			}
+		}
+
+		for (const Instruction& instruction : sampleStage) {
+			float* dst = sample(instruction.dst);
+			if (runElementwise(instruction.op, instruction.params, instruction.points, dst, sample(instruction.a), sample(instruction.b), samples))
+				continue;
+
+			switch (instruction.op) {
+				case Op::Broadcast: {
+					const float* src = column(instruction.a);
+					for (int i = 0; i < samples; i++) dst[i] = src[i / count.y];
+					break;
+				}
+				case Op::YGradient: {
+					for (int i = 0; i < samples; i++) {
+						float y = static_cast<float>(origin.y + (i % count.y) * step.y);
+						dst[i] = instruction.params[1] + (y - instruction.params[0]) * instruction.params[2];
+					}
+					break;
+				}
+				case Op::Noise3D: {
+					std::fill(dst, dst + samples, 0.0f);
+					float frequency = instruction.params[0];
+					float amplitude = instruction.params[1];
+					for (int octave = 0; octave < instruction.octaves; octave++) {
+						const float scale = 1.0f / frequency;
+						for (int i = 0; i < samples; i++) {
+							int columnIndex = i / count.y;
+							float x = static_cast<float>(origin.x + (columnIndex % count.x) * step.x);
+							float y = static_cast<float>(origin.y + (i % count.y) * step.y);
+							float z = static_cast<float>(origin.z + (columnIndex / count.x) * step.z);
+							dst[i] += amplitude * Noise::sample3D(instruction.seed, x * scale, y * scale, z * scale);
+						}
+						frequency /= 2;
+						amplitude /= 2;
+					}
+					break;
+				}
+				default:
+					break;
+			}
+		}
+
+		const float* result = sample(output);
+		out.assign(result, result + samples);
+	}
+}
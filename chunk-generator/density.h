@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "noise.h"
+
+using std::vector;
+
+using glm::vec2;
+using glm::ivec3;
+
+/*
+Data driven 3D terrain density, solid wherever density > 0
+A Graph is built out of nodes and compiled once into a Plan: a flat list of instructions
+over float registers. Nodes that do not depend on y run once per column, the rest once per
+sample, and every instruction is a plain loop over the whole batch so the compiler can
+vectorize it. Chunks sample the plan on a coarse grid and interpolate between samples
+*/
+namespace Density {
+	enum class Op : uint8_t {
+		Constant,
+		Noise2D,
+		Noise3D,
+		YGradient,
+		Add,
+		Mul,
+		Clamp,
+		Spline,
+		Broadcast, // copies a per column register into a per sample one, only emitted by compile
+
+		COUNT,
+	};
+
+	struct Node {
+		Op op = Op::Constant;
+		int a = -1, b = -1; // input nodes
+		float params[4]{}; // meaning depends on op, see the Graph builders
+		uint32_t seed = 0;
+		int octaves = 1;
+		vector<vec2> points{}; // spline control points (input, output), sorted by input
+	};
+
+	class Plan
+	{
+	public:
+		// evaluates density on count samples spaced step blocks apart, starting at origin
+		// out is indexed y + count.y * (x + count.x * z), each column's samples are contiguous
+		void evaluateGrid(ivec3 origin, ivec3 count, ivec3 step, vector<float>& out) const;
+
+		inline int instructionCount() const {
+			return static_cast<int>(columnStage.size() + sampleStage.size());
+		}
+
+	private:
+		friend class Graph;
+
+		struct Instruction {
+			Op op;
+			int dst, a, b; // registers
+			float params[4];
+			uint32_t seed;
+			int octaves;
+			vector<vec2> points;
+		};
+
+		vector<Instruction> columnStage;
+		vector<Instruction> sampleStage;
+		int columnRegisters = 0;
+		int sampleRegisters = 0;
+		int output = 0; // a sample register
+	};
+
+	class Graph
+	{
+	public:
+		int constant(float value);
+
+		// fractal noise, each extra octave halves the frequency and the amplitude like the heightmap does
+		// frequency is the inverse, in blocks per lattice cell
+		int noise2D(float frequency, float amplitude, int octaves = 1, uint32_t seed = 0);
+		int noise3D(float frequency, float amplitude, int octaves = 1, uint32_t seed = 0);
+
+		// linear in y, fromValue at fromY and toValue at toY
+		int yGradient(float fromY, float fromValue, float toY, float toValue);
+
+		int add(int a, int b);
+		int mul(int a, int b);
+		int clamp(int a, float low, float high);
+
+		// piecewise linear remap of a through (input, output) points, flat past either end
+		int spline(int a, vector<vec2> points);
+
+		// drops nodes the output doesn't use, folds constants and splits the rest by whether they depend on y
+		Plan compile(int output, uint32_t worldSeed) const;
+
+	private:
+		vector<Node> nodes;
+
+		int push(Node node);
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+using glm::vec3;
+using glm::vec4;
+using glm::mat4;
+
+/*
+The six planes of a view frustum, pulled straight out of a view projection matrix
+Normals point inwards and aren't normalized, which is fine for inside/outside tests
+*/
+class Frustum
+{
+public:
+	// accepts everything, for when there is no camera yet
+	Frustum() = default;
+
+	explicit Frustum(const mat4& viewProjection) : everything(false) {
+		// glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+		auto row = [&viewProjection](int i) {
+			return vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		};
+
+		planes[0] = row(3) + row(0); // left
+		planes[1] = row(3) - row(0); // right
+		planes[2] = row(3) + row(1); // bottom
+		planes[3] = row(3) - row(1); // top
+		planes[4] = row(3) + row(2); // near
+		planes[5] = row(3) - row(2); // far
+	}
+
+	// conservative, a box near a corner can pass without being visible
+	inline bool intersects(const vec3& min, const vec3& max) const {
+		if (everything) return true;
+
+		for (const vec4& plane : planes) {
+			// the corner furthest along the plane's normal
+			vec3 corner(plane.x >= 0 ? max.x : min.x, plane.y >= 0 ? max.y : min.y, plane.z >= 0 ? max.z : min.z);
+			if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0) return false;
+		}
+		return true;
+	}
+
+private:
+	vec4 planes[6];
+	bool everything = true;
+};
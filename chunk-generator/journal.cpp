@@ -0,0 +1,233 @@
+#include "journal.h"
+
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "meshcache.h"
+#include "profiler.h"
+#include "protocol.h"
+
+using std::vector;
+
+namespace {
+	vector<uint8_t> readFile(const std::string& path) {
+		vector<uint8_t> bytes;
+		FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file) return bytes;
+
+		uint8_t buffer[4096];
+		size_t read;
+		while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + read);
+		std::fclose(file);
+		return bytes;
+	}
+
+	uint32_t checksum(const vector<uint8_t>& bytes) {
+		return static_cast<uint32_t>(MeshCache::hashBytes(bytes.data(), bytes.size()));
+	}
+}
+
+std::string EditJournal::directoryFor(uint32_t seed, bool densityTerrain) {
+	// edits from before the world was cut into sections are keyed by columns, they stay where they were
+	return "saves/" + std::to_string(seed) + (densityTerrain ? "/density-section-edits" : "/section-edits");
+}
+
+EditJournal::EditJournal(std::string directory) : directory(std::move(directory)) {
+	PROFILE_SCOPE("EditJournal::open");
+	const auto start = std::chrono::steady_clock::now();
+
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+	if (error) {
+		std::cout << "ERR :: COULD NOT CREATE EDIT JOURNAL AT " << this->directory << ": " << error.message() << std::endl;
+		writable = false;
+	}
+
+	loadDeltas();
+	replayLog();
+
+	if (writable) {
+		log = std::fopen(logPath().c_str(), "ab");
+		if (!log) {
+			std::cout << "ERR :: COULD NOT OPEN EDIT LOG " << logPath() << ", EDITS WON'T BE SAVED" << std::endl;
+			writable = false;
+		}
+	}
+
+	stats.openMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+EditJournal::~EditJournal() {
+	if (!uncompacted.empty()) compact();
+	if (log) std::fclose(log);
+}
+
+std::string EditJournal::logPath() const {
+	return directory + "/journal.log";
+}
+
+std::string EditJournal::deltaPath(ivec3 coords) const {
+	return directory + "/" + std::to_string(coords.x) + "_" + std::to_string(coords.y) + "_" + std::to_string(coords.z) + ".delta";
+}
+
+void EditJournal::record(ivec3 chunk, ivec3 inChunk, Block::BlockType type) {
+	edits[chunk][indexOf(inChunk)] = type;
+	uncompacted.insert(chunk);
+	stats.recorded++;
+	if (!writable) return;
+
+	// length, payload, checksum of the payload
+	Protocol::Delta delta{ chunk, { { inChunk, type } } };
+	vector<uint8_t> payload = delta.encode();
+	vector<uint8_t> record;
+	Net::Writer writer(record);
+	writer.putBytes(payload);
+	writer.put<uint32_t>(checksum(payload));
+
+	// flushed so a crash of the game loses nothing, the log isn't synced to the disk though
+	if (std::fwrite(record.data(), 1, record.size(), log) != record.size() || std::fflush(log) != 0) {
+		std::cout << "ERR :: COULD NOT APPEND TO EDIT LOG " << logPath() << std::endl;
+		return;
+	}
+	logSize += static_cast<long>(record.size());
+	stats.bytesAppended += record.size();
+
+	if (logSize >= COMPACT_LOG_BYTES) compact();
+}
+
+size_t EditJournal::apply(ivec3 coords, Chunk& chunk) const {
+	auto found = edits.find(coords);
+	if (found == edits.end()) return 0;
+
+	for (const auto& [index, type] : found->second) chunk.placeBlock(coordsOf(index), type);
+	return found->second.size();
+}
+
+void EditJournal::compact() {
+	PROFILE_SCOPE("EditJournal::compact");
+	if (!writable) return;
+
+	// a crash part way leaves the log in place, replaying it over newer deltas sets the same blocks again
+	for (auto it = uncompacted.begin(); it != uncompacted.end();) {
+		if (!writeDelta(*it)) {
+			std::cout << "ERR :: COULD NOT WRITE " << deltaPath(*it) << ", KEEPING THE EDIT LOG" << std::endl;
+			return;
+		}
+		stats.deltasWritten++;
+		it = uncompacted.erase(it);
+	}
+
+	std::fclose(log);
+	log = std::fopen(logPath().c_str(), "wb");
+	if (!log) {
+		std::cout << "ERR :: COULD NOT REOPEN EDIT LOG " << logPath() << ", EDITS WON'T BE SAVED" << std::endl;
+		writable = false;
+	}
+	logSize = 0;
+	stats.compactions++;
+}
+
+bool EditJournal::writeDelta(ivec3 coords) const {
+	Protocol::Delta delta{ coords, {} };
+	for (const auto& [index, type] : edits.at(coords)) delta.changes.push_back({ coordsOf(index), type });
+	vector<uint8_t> payload = delta.encode();
+
+	vector<uint8_t> bytes;
+	Net::Writer writer(bytes);
+	writer.put<uint32_t>(MAGIC);
+	writer.put<uint32_t>(VERSION);
+	writer.putBytes(payload);
+	writer.put<uint32_t>(checksum(payload));
+
+	// written under a temporary name so a crash never leaves a truncated delta behind
+	std::string path = deltaPath(coords);
+	std::string tempPath = path + ".tmp";
+	FILE* file = std::fopen(tempPath.c_str(), "wb");
+	if (!file) return false;
+	bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	written = std::fclose(file) == 0 && written;
+
+	std::error_code error;
+	if (written) std::filesystem::rename(tempPath, path, error);
+	if (!written || error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+void EditJournal::loadDeltas() {
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		if (entry.path().extension() != ".delta") continue;
+
+		vector<uint8_t> bytes = readFile(entry.path().string());
+		Net::Reader reader(bytes);
+		bool valid = reader.get<uint32_t>() == MAGIC && reader.get<uint32_t>() == VERSION;
+		vector<uint8_t> payload = reader.getBytes();
+		valid = valid && reader.get<uint32_t>() == checksum(payload) && reader.ok;
+
+		std::optional<Protocol::Delta> delta;
+		if (valid) delta = Protocol::Delta::decode(payload);
+		if (!delta) {
+			std::cout << "ERR :: SKIPPING CORRUPT EDIT DELTA " << entry.path().string() << std::endl;
+			continue;
+		}
+
+		auto& chunkEdits = edits[delta->coords];
+		for (const Protocol::Delta::Change& change : delta->changes) chunkEdits[indexOf(change.coords)] = change.type;
+	}
+}
+
+void EditJournal::replayLog() {
+	vector<uint8_t> bytes = readFile(logPath());
+	Net::Reader reader(bytes);
+
+	size_t intact = 0;
+	while (intact < bytes.size()) {
+		vector<uint8_t> payload = reader.getBytes();
+		uint32_t expected = reader.get<uint32_t>();
+		if (!reader.ok || expected != checksum(payload)) break;
+
+		std::optional<Protocol::Delta> delta = Protocol::Delta::decode(payload);
+		if (!delta) break;
+
+		auto& chunkEdits = edits[delta->coords];
+		for (const Protocol::Delta::Change& change : delta->changes) chunkEdits[indexOf(change.coords)] = change.type;
+		uncompacted.insert(delta->coords);
+
+		intact += sizeof(uint32_t) + payload.size() + sizeof(uint32_t);
+		stats.replayed++;
+	}
+	logSize = static_cast<long>(intact);
+
+	// appends go after the last intact record, not after the torn one
+	if (intact < bytes.size()) {
+		stats.dropped = bytes.size() - intact;
+		std::cout << "ERR :: DROPPING " << stats.dropped << " TORN BYTES AT THE END OF " << logPath() << std::endl;
+		std::error_code error;
+		std::filesystem::resize_file(logPath(), intact, error);
+		if (error) writable = false;
+	}
+}
+
+void EditJournal::printStats(std::ostream& os) const {
+	size_t blocks = 0;
+	for (const auto& entry : edits) blocks += entry.second.size();
+	os << "Edit journal: " << blocks << " blocks edited in " << edits.size() << " chunks, " << stats.recorded << " recorded, "
+		<< (stats.recorded ? stats.bytesAppended / stats.recorded : 0) << " bytes per edit, log at " << logSize / 1024 << "KB, "
+		<< stats.compactions << " compactions, " << stats.replayed << " replayed on open in " << stats.openMicros / 1000.0 << "ms\n";
+}
+
+void EditJournal::reportMemory(MemoryReport& report) const {
+	size_t blocks = 0;
+	for (const auto& entry : edits) blocks += entry.second.size();
+	report.add("journal", "chunks", edits.size());
+	report.add("journal", "blocks", blocks);
+	// map nodes hold a key, a value and about three pointers and a colour
+	report.add("journal", "approxBytes", edits.size() * sizeof(decltype(edits)::value_type) + blocks * (4 * sizeof(void*)));
+}
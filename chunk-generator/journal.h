@@ -0,0 +1,116 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "block.h"
+#include "chunk.h"
+#include "memory.h"
+#include "vecn_hash.hpp"
+
+using glm::ivec3;
+
+/*
+The player's block edits, the only part of a world worth saving
+Terrain comes back from the seed, so only edits are kept: appended to a log as they happen
+and replayed on top of freshly generated chunks. Once the log grows past COMPACT_LOG_BYTES
+every chunk it touched gets its edits rewritten into a delta file of its own and the log starts over.
+Log records carry a checksum, a torn record at the end from a crash is dropped on open
+Main thread only
+*/
+class EditJournal
+{
+public:
+	// the log is compacted once it is this big, and when the journal closes
+	static constexpr long COMPACT_LOG_BYTES = 1024 * 1024;
+
+	struct Stats {
+		uint64_t recorded = 0;
+		uint64_t bytesAppended = 0;
+		uint64_t compactions = 0;
+		uint64_t deltasWritten = 0;
+		uint64_t replayed = 0; // log records found on open
+		uint64_t dropped = 0; // torn or corrupt bytes cut off the end of the log on open
+		int64_t openMicros = 0;
+	};
+
+	// where a world's edits are kept, terrain types don't share them
+	static std::string directoryFor(uint32_t seed, bool densityTerrain);
+
+	// directory is created if it doesn't exist yet, then the deltas are read and the log replayed
+	explicit EditJournal(std::string directory);
+
+	~EditJournal();
+
+	EditJournal(const EditJournal&) = delete;
+	EditJournal& operator=(const EditJournal&) = delete;
+
+	// written through to the log straight away, type 0 for a removed block
+	void record(ivec3 chunk, ivec3 inChunk, Block::BlockType type);
+
+	// puts every edit of the chunk back, for freshly generated chunks before they are lit
+	// returns how many blocks were set
+	size_t apply(ivec3 coords, Chunk& chunk) const;
+
+	// rewrites the delta of every chunk edited since the last compaction and empties the log
+	void compact();
+
+	inline const Stats& getStats() const {
+		return stats;
+	}
+
+	inline long logBytes() const {
+		return logSize;
+	}
+
+	void printStats(std::ostream& os) const;
+
+	void reportMemory(MemoryReport& report) const;
+
+private:
+	static constexpr uint32_t MAGIC = 0x54494445; // "EDIT"
+	static constexpr uint32_t VERSION = 2; // 2 keys deltas by section
+
+	std::string directory;
+	bool writable = true;
+
+	FILE* log = nullptr;
+	long logSize = 0;
+
+	// latest type of every edited block, by chunk and then by index into the chunk's blocks
+	std::unordered_map<ivec3, std::map<uint16_t, Block::BlockType>, vec3Hash> edits;
+
+	// chunks whose delta on disk is behind edits
+	std::unordered_set<ivec3, vec3Hash> uncompacted;
+
+	Stats stats;
+
+	std::string logPath() const;
+	std::string deltaPath(ivec3 coords) const;
+
+	void loadDeltas();
+
+	// applies every intact record and cuts whatever follows the last one off
+	void replayLog();
+
+	// false if the file couldn't be written, the old one is left alone then
+	bool writeDelta(ivec3 coords) const;
+
+	// indices fit 16 bits, a 32 block section holds 32768 of them
+	static_assert(CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z <= 65536, "chunk indices must fit 16 bits");
+
+	static inline uint16_t indexOf(ivec3 inChunk) {
+		return static_cast<uint16_t>(inChunk.x + CHUNK_MAX_X * (inChunk.z + CHUNK_MAX_Z * inChunk.y));
+	}
+
+	static inline ivec3 coordsOf(uint16_t index) {
+		return ivec3(index % CHUNK_MAX_X, index / (CHUNK_MAX_X * CHUNK_MAX_Z), (index / CHUNK_MAX_X) % CHUNK_MAX_Z);
+	}
+};
@@ -0,0 +1,306 @@
+#include "light.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "profiler.h"
+
+namespace Light {
+	Engine::Engine(ChunkMap& chunks) : chunks(chunks) {
+		const Block::BlockRegistry& registry = Block::BlockRegistry::getInstance();
+		for (size_t type = 0; type < registry.size() && type < emission.size(); type++) {
+			emission[type] = std::min<uint8_t>(registry.getDef(static_cast<Block::BlockType>(type)).lightEmission, MAX_LEVEL);
+		}
+	}
+
+	bool Engine::resolve(ivec3 worldPosition, Cell& cell) {
+		if (worldPosition.y < 0 || worldPosition.y >= WORLD_HEIGHT) return false;
+
+		ivec3 coords(Noise::floorDiv(worldPosition.x, CHUNK_MAX_X), Noise::floorDiv(worldPosition.y, CHUNK_MAX_Y), Noise::floorDiv(worldPosition.z, CHUNK_MAX_Z));
+		if (lastChunk == nullptr || coords != lastCoords) {
+			auto found = chunks.find(coords);
+			if (found == chunks.end()) return false;
+			lastChunk = found->second.get();
+			lastCoords = coords;
+		}
+		if (lastChunk->isCold()) return false;
+
+		cell.chunk = lastChunk;
+		cell.chunkCoords = coords;
+		cell.local = worldPosition - coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+		return true;
+	}
+
+	bool Engine::step(const Cell& from, ivec3 worldPosition, int face, Cell& to) {
+		ivec3 local = from.local + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]);
+		if (ChunkLight::inBounds(local.x, local.y, local.z)) {
+			to.chunk = from.chunk;
+			to.chunkCoords = from.chunkCoords;
+			to.local = local;
+			return true;
+		}
+		return resolve(worldPosition + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]), to);
+	}
+
+	bool Engine::canBrighten(const Cell& from, const Cell& to, Channel channel, int face) const {
+		int level = getLevel(from.chunk->getLight(from.local), channel);
+		int nextLevel = channel == SKY && face == 5 && level == MAX_LEVEL ? MAX_LEVEL : level - 1;
+		return tags.transparent[to.chunk->getBlock(to.local)] && getLevel(to.chunk->getLight(to.local), channel) < nextLevel;
+	}
+
+	void Engine::markDirty(const Cell& cell) {
+		dirty.insert(cell.chunkCoords);
+
+		for (int face = 0; face < 6; face++) {
+			ivec3 offset(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]);
+			ivec3 next = cell.local + offset;
+			if (!ChunkLight::inBounds(next.x, next.y, next.z)) dirty.insert(cell.chunkCoords + offset);
+		}
+	}
+
+	bool Engine::skyAbove(ivec3 worldPosition) {
+		Cell above;
+		if (!resolve(worldPosition + ivec3(0, 1, 0), above)) return true;
+		return getLevel(above.chunk->getLight(above.local), SKY) == MAX_LEVEL;
+	}
+
+	void Engine::propagate(Channel channel) {
+		std::queue<ivec3>& queue = fill[channel];
+
+		while (!queue.empty()) {
+			ivec3 position = queue.front();
+			queue.pop();
+
+			Cell cell;
+			if (!resolve(position, cell)) continue;
+			int level = getLevel(cell.chunk->getLight(cell.local), channel);
+			if (level <= 1) continue;
+
+			for (int face = 0; face < 6; face++) {
+				Cell neighbour;
+				if (!step(cell, position, face, neighbour)) continue;
+				if (!tags.transparent[neighbour.chunk->getBlock(neighbour.local)]) continue;
+
+				// full sky light keeps its strength going down, face 5 is bottom
+				int nextLevel = channel == SKY && face == 5 && level == MAX_LEVEL ? MAX_LEVEL : level - 1;
+
+				uint8_t light = neighbour.chunk->getLight(neighbour.local);
+				if (getLevel(light, channel) >= nextLevel) continue;
+
+				ivec3 next = position + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]);
+				neighbour.chunk->setLight(neighbour.local, setLevel(light, channel, nextLevel));
+				markDirty(neighbour);
+				queue.push(next);
+				stats.cellsLit++;
+			}
+		}
+	}
+
+	void Engine::unpropagate(Channel channel) {
+		std::queue<Removal>& queue = removal[channel];
+
+		while (!queue.empty()) {
+			Removal removed = queue.front();
+			queue.pop();
+
+			Cell cell;
+			if (!resolve(removed.position, cell)) continue;
+
+			for (int face = 0; face < 6; face++) {
+				ivec3 next = removed.position + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]);
+
+				Cell neighbour;
+				if (!step(cell, removed.position, face, neighbour)) continue;
+
+				uint8_t light = neighbour.chunk->getLight(neighbour.local);
+				int level = getLevel(light, channel);
+				if (level == 0) continue;
+
+				bool fedByRemoved = level < removed.level
+					|| (channel == SKY && face == 5 && removed.level == MAX_LEVEL);
+
+				if (!fedByRemoved) {
+					// lit from somewhere else, it refills what was cleared
+					fill[channel].push(next);
+					continue;
+				}
+
+				neighbour.chunk->setLight(neighbour.local, setLevel(light, channel, 0));
+				markDirty(neighbour);
+				queue.push({ next, level });
+				stats.cellsCleared++;
+
+				// a light source caught in the cleared area shines again once the removal is done
+				uint8_t source = emission[neighbour.chunk->getBlock(neighbour.local)];
+				if (channel == BLOCK && source > 0) {
+					neighbour.chunk->setLight(neighbour.local, setLevel(light, channel, source));
+					fill[channel].push(next);
+				}
+			}
+		}
+	}
+
+	void Engine::addChunk(ivec3 coords) {
+		PROFILE_SCOPE("Light::addChunk");
+		auto found = chunks.find(coords);
+		if (found == chunks.end() || found->second->isCold()) return;
+		Chunk& chunk = *found->second;
+
+		const ivec3 origin = coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+
+		// sky light falls straight down each column until the first block that stops it
+		// lowestLit is the bottom of that open stretch, CHUNK_MAX_Y if no sky reaches the column
+		// unlit chunks start dark, heightmap chunks only keep light their heights got wrong
+		int lowestLit[CHUNK_MAX_X][CHUNK_MAX_Z];
+		for (int z = 0; z < CHUNK_MAX_Z; z++) {
+			for (int x = 0; x < CHUNK_MAX_X; x++) {
+				const uint8_t sky = skyAbove(origin + ivec3(x, CHUNK_MAX_Y - 1, z)) ? OPEN_SKY : 0;
+				int y = CHUNK_MAX_Y - 1;
+				for (; y >= 0 && tags.transparent[chunk.getBlock({ x, y, z })]; y--) {
+					if (chunk.getLight({ x, y, z }) != sky) chunk.setLight({ x, y, z }, sky);
+				}
+				lowestLit[x][z] = sky ? y + 1 : CHUNK_MAX_Y;
+
+				for (; y >= 0; y--) {
+					if (chunk.getLight({ x, y, z }) != 0) chunk.setLight({ x, y, z }, 0);
+				}
+			}
+		}
+
+		for (int z = 0; z < CHUNK_MAX_Z; z++) {
+			for (int x = 0; x < CHUNK_MAX_X; x++) {
+				// sky light only has somewhere to go where a lit cell sits next to a darker open one,
+				// which can only be beside the lit part of the column and under a taller neighbour
+				for (int face = 0; face < 4; face++) {
+					int nx = x + Mesher::FACE_OFFSETS[face][0];
+					int nz = z + Mesher::FACE_OFFSETS[face][2];
+					if (nx < 0 || nx >= CHUNK_MAX_X || nz < 0 || nz >= CHUNK_MAX_Z) continue;
+
+					for (int y = lowestLit[x][z]; y < lowestLit[nx][nz]; y++) {
+						if (tags.transparent[chunk.getBlock({ nx, y, nz })]) fill[SKY].push(origin + ivec3(x, y, z));
+					}
+				}
+
+				for (int y = 0; y < CHUNK_MAX_Y; y++) {
+					uint8_t source = emission[chunk.getBlock({ x, y, z })];
+					if (source == 0) continue;
+					chunk.setLight({ x, y, z }, setLevel(chunk.getLight({ x, y, z }), BLOCK, source));
+					fill[BLOCK].push(origin + ivec3(x, y, z));
+				}
+			}
+		}
+
+		// the chunk below took the sky above it for open while this one wasn't loaded,
+		// its full sky goes wherever this one doesn't pass full sky down
+		for (int z = 0; z < CHUNK_MAX_Z; z++) {
+			for (int x = 0; x < CHUNK_MAX_X; x++) {
+				if (getLevel(chunk.getLight({ x, 0, z }), SKY) == MAX_LEVEL) continue;
+
+				ivec3 position = origin + ivec3(x, -1, z);
+				Cell below;
+				if (!resolve(position, below)) break;
+				uint8_t light = below.chunk->getLight(below.local);
+				if (getLevel(light, SKY) != MAX_LEVEL) continue;
+
+				below.chunk->setLight(below.local, setLevel(light, SKY, 0));
+				markDirty(below);
+				removal[SKY].push({ position, MAX_LEVEL });
+			}
+		}
+		unpropagate(SKY);
+
+		// light crosses each loaded side wherever one chunk could brighten the other
+		for (int face = 0; face < 6; face++) {
+			const ivec3 offset(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]);
+			const ivec3 neighbourCoords = coords + offset;
+			auto neighbour = chunks.find(neighbourCoords);
+			if (neighbour == chunks.end() || neighbour->second->isCold()) continue;
+
+			// its faces along this side were meshed against open sky, even where no light crosses
+			dirty.insert(neighbourCoords);
+
+			const int opposite = face ^ 1; // faces come in +/- pairs
+			for (int v = 0; v < CHUNK_MAX_X; v++) {
+				for (int u = 0; u < CHUNK_MAX_X; u++) {
+					ivec3 inside = Mesher::sideCell<CHUNK_MAX_X>(face, u, v);
+					ivec3 outside = inside + offset;
+
+					Cell here{ &chunk, coords, inside };
+					Cell there{ neighbour->second.get(), neighbourCoords, outside - offset * CHUNK_MAX_X };
+
+					for (int channel = 0; channel < CHANNEL_COUNT; channel++) {
+						if (canBrighten(here, there, Channel(channel), face)) fill[channel].push(origin + inside);
+						if (canBrighten(there, here, Channel(channel), opposite)) fill[channel].push(origin + outside);
+					}
+				}
+			}
+		}
+
+		propagate(SKY);
+		propagate(BLOCK);
+
+		dirty.insert(coords);
+		stats.chunksLit++;
+	}
+
+	void Engine::blockChanged(ivec3 worldPosition, Block::BlockType oldType) {
+		PROFILE_SCOPE("Light::blockChanged");
+		const auto start = std::chrono::steady_clock::now();
+
+		Cell cell;
+		if (!resolve(worldPosition, cell)) return;
+		Chunk* chunk = cell.chunk;
+		const ivec3 local = cell.local;
+		markDirty(cell);
+
+		const Block::BlockType newType = chunk->getBlock(local);
+		const bool transparent = tags.transparent[newType];
+
+		for (int c = 0; c < CHANNEL_COUNT; c++) {
+			Channel channel = Channel(c);
+			uint8_t light = chunk->getLight(local);
+			int level = getLevel(light, channel);
+
+			// the cell's own light goes if it now blocks light, or if it came from the block that was replaced
+			bool lostSource = channel == BLOCK && emission[oldType] > 0;
+			if (level > 0 && (!transparent || lostSource)) {
+				chunk->setLight(local, setLevel(light, channel, 0));
+				removal[channel].push({ worldPosition, level });
+				unpropagate(channel);
+			}
+
+			// an opening lets the neighbours shine back in
+			if (transparent) {
+				for (int face = 0; face < 6; face++) {
+					fill[channel].push(worldPosition + ivec3(Mesher::FACE_OFFSETS[face][0], Mesher::FACE_OFFSETS[face][1], Mesher::FACE_OFFSETS[face][2]));
+				}
+				if (channel == SKY && skyAbove(worldPosition)) {
+					chunk->setLight(local, setLevel(chunk->getLight(local), SKY, MAX_LEVEL));
+					fill[SKY].push(worldPosition);
+				}
+			}
+
+			if (channel == BLOCK && emission[newType] > 0) {
+				chunk->setLight(local, setLevel(chunk->getLight(local), BLOCK, emission[newType]));
+				fill[BLOCK].push(worldPosition);
+			}
+
+			propagate(channel);
+		}
+
+		stats.edits++;
+		stats.editMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	vector<ivec3> Engine::takeDirty() {
+		vector<ivec3> result(dirty.begin(), dirty.end());
+		dirty.clear();
+		return result;
+	}
+
+	void Engine::printStats(std::ostream& os) const {
+		os << "Light: " << stats.chunksLit << " chunks lit, " << stats.edits << " edits at "
+			<< (stats.edits ? stats.editMicros / static_cast<double>(stats.edits) : 0.0) << "us avg, "
+			<< stats.cellsLit << " cells lit, " << stats.cellsCleared << " cleared\n";
+	}
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include "chunk.h"
+#include "mesher.h"
+#include "vecn_hash.hpp"
+
+using std::vector;
+
+using glm::ivec3;
+
+/*
+Per block sky light and block light, 0 to 15 each, packed into one byte per block
+Both spread by breadth first flood fill and lose a level per step, except sky light at full
+strength which falls straight down without fading, from chunk to chunk down a column. The sky
+is open above the world and above chunks that aren't loaded yet. Edits only revisit the cells whose light
+they change: darkening runs a removal pass that clears everything the old light fed and hands
+the edges back to the fill, so nothing is ever recomputed for a whole chunk
+*/
+namespace Light {
+	constexpr int MAX_LEVEL = 15;
+
+	// what faces see above the world and next to chunks that aren't loaded
+	constexpr uint8_t OPEN_SKY = MAX_LEVEL << 4;
+
+	enum Channel {
+		SKY,
+		BLOCK,
+
+		CHANNEL_COUNT,
+	};
+
+	inline int getLevel(uint8_t light, Channel channel) {
+		return channel == SKY ? light >> 4 : light & 0x0F;
+	}
+
+	inline uint8_t setLevel(uint8_t light, Channel channel, int level) {
+		return channel == SKY
+			? static_cast<uint8_t>((light & 0x0F) | (level << 4))
+			: static_cast<uint8_t>((light & 0xF0) | level);
+	}
+
+	class Engine
+	{
+	public:
+		struct Stats {
+			uint64_t chunksLit = 0;
+			uint64_t edits = 0;
+			uint64_t cellsLit = 0; // light raised by a fill
+			uint64_t cellsCleared = 0; // light removed by a removal pass
+			int64_t editMicros = 0;
+		};
+
+		Engine(ChunkMap& chunks);
+
+		// lights a newly generated chunk and trades light with the loaded chunks around it, which all remesh
+		// call it as soon as the chunk is in the map, light spreading into an unlit chunk would be overwritten
+		// the sky it blocks is taken back from the chunk below, which was lit as if it were open
+		void addChunk(ivec3 coords);
+
+		// relights around a block that was just changed from oldType to whatever is there now
+		void blockChanged(ivec3 worldPosition, Block::BlockType oldType);
+
+		// chunks with light changes their meshes don't show yet, cleared by the call
+		vector<ivec3> takeDirty();
+
+		inline const Stats& getStats() const {
+			return stats;
+		}
+
+		void printStats(std::ostream& os) const;
+
+	private:
+		struct Cell {
+			Chunk* chunk;
+			ivec3 chunkCoords;
+			ivec3 local;
+		};
+
+		struct Removal {
+			ivec3 position;
+			int level;
+		};
+
+		ChunkMap& chunks;
+
+		Mesher::TagTable tags;
+		std::array<uint8_t, 256> emission{};
+
+		// world positions, the level is read back from the chunk when a cell is popped
+		std::queue<ivec3> fill[CHANNEL_COUNT];
+		std::queue<Removal> removal[CHANNEL_COUNT];
+
+		std::unordered_set<ivec3, vec3Hash> dirty;
+
+		// the fill mostly stays inside one chunk, so the last lookup is kept
+		ivec3 lastCoords{};
+		Chunk* lastChunk = nullptr;
+
+		Stats stats;
+
+		// false outside the world's height or in chunks that aren't loaded or are cold
+		bool resolve(ivec3 worldPosition, Cell& cell);
+
+		// the cell one step from another, without a chunk lookup unless the step leaves the chunk
+		bool step(const Cell& from, ivec3 worldPosition, int face, Cell& to);
+
+		// whether light at level in from could raise the level of to
+		bool canBrighten(const Cell& from, const Cell& to, Channel channel, int face) const;
+
+		// the cell's own chunk, plus the neighbouring chunks whose border faces look into it
+		void markDirty(const Cell& cell);
+
+		// whether full sky light comes down into the cell from above, always above the world and unloaded chunks
+		bool skyAbove(ivec3 worldPosition);
+
+		void propagate(Channel channel);
+		void unpropagate(Channel channel);
+	};
+}
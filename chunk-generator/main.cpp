@@ -8,12 +8,28 @@
 #include "stb_image.h"
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <csignal>
 #include <exception>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
+#include "bench.h"
 #include "block.h"
 #include "camera.h"
+#include "client.h"
 #include "player.h"
+#include "profiler.h"
+#include "recording.h"
+#include "server.h"
 #include "shader.h"
+#include "uniformbuffer.h"
+#include "uploader.h"
 #include "world.h"
 
 using glm::vec3;
@@ -26,6 +42,19 @@ GLFWwindow * window;
 Player * gPlayer = nullptr;
 World * gWorld = nullptr;
 
+// set while recording, edits made with the mouse are added to it
+Recording * gRecording = nullptr;
+
+// replays ignore mouse edits, the recording's are applied instead
+bool replaying = false;
+
+// set by ctrl+c or a kill, --serve then finishes its step and shuts down
+std::atomic<bool> stopServing{ false };
+
+void requestServerStop(int) {
+	stopServing = true;
+}
+
 void frame_buffer_size_callback(GLFWwindow* window, int width, int height) {
 	glViewport(0, 0, width, height);
 }
@@ -34,10 +63,12 @@ float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
 void process_input(GLFWwindow* window) {
+	PROFILE_SCOPE("process_input");
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
 	}
 	Camera& camera = gPlayer->camera;
+	const glm::vec3 start = camera.Position;
 	bool hasMoved = false;
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
 		camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -57,10 +88,17 @@ void process_input(GLFWwindow* window) {
 	}
 	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
 		camera.ProcessKeyboard(UP, deltaTime);
+		hasMoved = true;
 	}
 	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
 		camera.ProcessKeyboard(DOWN, deltaTime);
+		hasMoved = true;
 	}
+
+	// the camera moved freely, move the player there through the world instead
+	const glm::vec3 target = camera.Position;
+	camera.Position = start;
+	if (target != start) gPlayer->moveTo(*gWorld, target);
 	if (hasMoved) {
 		gWorld->loadChunks(gPlayer->getChunkCoords());
 	}
@@ -78,23 +116,72 @@ void process_mouse_movement(GLFWwindow* window, double xPos, double yPos) {
 	gPlayer->camera.ProcessMouseMovement(xOffset, yOffset, true);
 }
 
+// what right click places, picked with the number keys
+Block::BlockType placeType = 1;
+
 void process_mouse_click(GLFWwindow* window, int button, int action, int mods) {
+	if (replaying) return;
+
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && gPlayer->getSelected().hit) {
 		gWorld->removeBlockAt(gPlayer->getSelected().coords);
+		if (gRecording) gRecording->addEdit(gPlayer->getSelected().coords, 0);
 	}
 	else if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS && gPlayer->getSelected().hit) {
 		ivec3 target = gPlayer->getSelected().coords + gPlayer->getSelected().normal;
 		if (gWorld->getBlockDef(target).hasTag(Block::BlockTag::Air)) {
-			gWorld->placeBlockAt(target, 1);
+			gWorld->placeBlockAt(target, placeType);
+			if (gRecording) gRecording->addEdit(target, placeType);
 		}
 	}
 }
 
-void initialize() {
+// moves the camera along the recording and makes the edits due this tick
+void apply_replay_tick(const Recording& replay, size_t tick, size_t& nextEdit) {
+	PROFILE_SCOPE("apply_replay_tick");
+	for (; nextEdit < replay.edits.size() && replay.edits[nextEdit].tick == tick; nextEdit++) {
+		const Recording::Edit& edit = replay.edits[nextEdit];
+		if (edit.type == 0) gWorld->removeBlockAt(edit.coords);
+		else gWorld->placeBlockAt(edit.coords, edit.type);
+	}
+
+	const Recording::Tick& pose = replay.ticks[tick];
+	gPlayer->camera.SetPose(pose.position, pose.yaw, pose.pitch);
+	gWorld->loadChunks(gPlayer->getChunkCoords());
+}
+
+void process_key_press(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	if (action != GLFW_PRESS) return;
+
+	Profiler& profiler = Profiler::getInstance();
+	if (key == GLFW_KEY_F3) {
+		profiler.setEnabled(!profiler.isEnabled());
+	}
+	else if (key == GLFW_KEY_F4) {
+		profiler.printSummary(std::cout);
+		profiler.dumpChromeTrace("profile.json");
+		gWorld->printStats(std::cout);
+	}
+	else if (key == GLFW_KEY_N) {
+		gPlayer->collides = !gPlayer->collides;
+	}
+	else if (key == GLFW_KEY_F5) {
+		MemoryReport report = gWorld->memoryReport();
+		report.print(std::cout);
+		report.dumpJson("memory.json");
+	}
+	else if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9) {
+		Block::BlockType type = static_cast<Block::BlockType>(key - GLFW_KEY_1 + 1);
+		if (type < Block::BlockRegistry::getInstance().size()) placeType = type;
+	}
+}
+
+// a headless window is never shown, it only provides the GL context
+void initialize(bool headless) {
 	glfwInit();
 	glfwWindowHint(GLFW_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_SAMPLES, 4);
+	glfwWindowHint(GLFW_VISIBLE, headless ? GLFW_FALSE : GLFW_TRUE);
 
 	window = glfwCreateWindow(WIDTH, HEIGHT, "ChunkGenerator", NULL, NULL);
 	if (window == nullptr) {
@@ -114,6 +201,7 @@ void initialize() {
 	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 	glfwSetCursorPosCallback(window, &process_mouse_movement);
 	glfwSetMouseButtonCallback(window, &process_mouse_click);
+	glfwSetKeyCallback(window, &process_key_press);
 
 	glEnable(GL_CULL_FACE);
 	glEnable(GL_DEPTH_TEST);
@@ -122,75 +210,121 @@ void initialize() {
 	std::cerr << "Finished Initialization!" << std::endl;
 }
 
-unsigned int loadTexture(char const * path) {
-	stbi_set_flip_vertically_on_load(true);
-	int width, height, nrChannels;
-	unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-
-	if (!data) {
-		std::cout << "ERR :: IMAGE FAILED TO LOAD" << std::endl;
+// packs every registered block texture into one GL_TEXTURE_2D_ARRAY, layer i is texture path i
+// all images must share a size, they are expanded to RGBA so formats can differ
+unsigned int loadBlockTextures() {
+	const auto& paths = Block::BlockRegistry::getInstance().getTexturePaths();
+	if (paths.empty()) {
+		std::cout << "ERR :: NO BLOCK TEXTURES REGISTERED" << std::endl;
 		return 0;
 	}
 
-	GLenum format;
-	if (nrChannels == 1)
-		format = GL_RED;
-	else if (nrChannels == 3)
-		format = GL_RGB;
-	else if (nrChannels == 4)
-		format = GL_RGBA;
+	// the layer size comes from the first readable header, so the array exists even if some images fail to load
+	int layerWidth = 0, layerHeight = 0;
+	for (const std::string& path : paths) {
+		int nrChannels;
+		if (stbi_info(path.c_str(), &layerWidth, &layerHeight, &nrChannels)) break;
+	}
+	if (layerWidth == 0 || layerHeight == 0) {
+		std::cout << "ERR :: NO BLOCK TEXTURE COULD BE READ" << std::endl;
+		return 0;
+	}
 
-	//glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	stbi_set_flip_vertically_on_load(true);
 
-	// setup texture
 	unsigned int texture;
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerWidth, layerHeight, static_cast<GLsizei>(paths.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	for (size_t layer = 0; layer < paths.size(); layer++) {
+		int width, height, nrChannels;
+		unsigned char* data = stbi_load(paths[layer].c_str(), &width, &height, &nrChannels, 4);
+
+		if (!data) {
+			std::cout << "ERR :: IMAGE FAILED TO LOAD: " << paths[layer] << std::endl;
+			continue;
+		}
+
+		if (width != layerWidth || height != layerHeight) {
+			std::cout << "ERR :: TEXTURE SIZE MISMATCH: " << paths[layer] << " is " << width << "x" << height
+				<< ", expected " << layerWidth << "x" << layerHeight << std::endl;
+		}
+		else {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer), width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-	glGenerateMipmap(GL_TEXTURE_2D);
+		stbi_image_free(data);
+	}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
 
-	stbi_image_free(data);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	return texture;
 }
 
-void draw(Shader& blockShader, glm::vec3& lightColour)
-{
+// the block shader maps (block type, face) to a layer through this table, so meshes don't depend on texture assignments
+void uploadFaceLayers(const Shader& blockShader) {
+	using namespace Block;
+	const BlockRegistry& registry = BlockRegistry::getInstance();
+
+	std::vector<int> layers(MAX_BLOCK_TYPES * 6, 0);
+	for (size_t type = 0; type < registry.size(); type++) {
+		const BlockDef& def = registry.getDef(static_cast<BlockType>(type));
+		std::copy(def.textureIndices, def.textureIndices + 6, &layers[type * 6]);
+	}
+
+	// packed four to an ivec4, plain int arrays can take a whole vec4 slot each
 	blockShader.use();
-	mat4 view = gPlayer->camera.GetViewMatrix();
-	static mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, (float)RENDER_DISTANCE * std::max(CHUNK_MAX_X, CHUNK_MAX_Z));
-	blockShader.setMat4("view", view);
-	blockShader.setMat4("projection", projection);
+	glUniform4iv(blockShader.getUniformLocation("faceLayers"), MAX_BLOCK_TYPES * 6 / 4, layers.data());
+	blockShader.setInt("blockTextures", 0);
+}
+
+// every program reads the camera and lighting from the shared frame uniforms
+Shader loadShader(const char* vertexPath, const char* fragmentPath) {
+	Shader shader(vertexPath, fragmentPath);
+	shader.bindUniformBlock("Frame", FRAME_UNIFORMS_BINDING);
+	return shader;
+}
+
+const mat4& projectionMatrix() {
+	static const mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, (float)RENDER_DISTANCE * std::max(CHUNK_MAX_X, CHUNK_MAX_Z));
+	return projection;
+}
 
-	glm::ivec2 playerChunk = gPlayer->getChunkCoords();
+void updateFrameUniforms(const UniformBuffer& frameUniforms, const glm::vec3& lightColour) {
+	PROFILE_SCOPE("updateFrameUniforms");
+	FrameUniforms frame;
+	frame.view = gPlayer->camera.GetViewMatrix();
+	frame.projection = projectionMatrix();
 
-	blockShader.setVec3("lightColour", lightColour);
-	blockShader.setVec3("material.ambient", 1.0f, 0.5f, 0.31f);
-	blockShader.setVec3("material.diffuse", 1.0f, 0.5f, 0.31f);
-	blockShader.setVec3("material.specular", vec3(0.1f));
-	blockShader.setFloat("material.shininess", 128.0f);
+	frame.lightDirection = glm::normalize(frame.view * glm::vec4(cos(glfwGetTime() / 2.0f), 0.2f, sin(glfwGetTime() / 2.0f), 0.0f));
+	frame.lightAmbient = glm::vec4(lightColour * glm::vec3(0.2f), 1.0f);
+	frame.lightDiffuse = glm::vec4(lightColour * glm::vec3(0.5f), 1.0f);
+	frame.lightSpecular = glm::vec4(1.0f);
+	frame.material = glm::vec4(128.0f, 0.0f, 0.0f, 0.0f); // shininess
 
-	glm::vec3 ambientColor = lightColour * glm::vec3(0.2f);
-	glm::vec3 diffuseColor = lightColour * glm::vec3(0.5f);
-	glm::vec3 specularColour = glm::vec3(1.0f);
+	frameUniforms.update(&frame);
+}
 
-	glm::vec3 lightDir = glm::normalize(view * glm::vec4(cos(glfwGetTime() / 2.0f), 0.2f, sin(glfwGetTime() / 2.0f), 0.0f));
-	blockShader.setVec3("light.ambient", ambientColor);
-	blockShader.setVec3("light.diffuse", diffuseColor);
-	blockShader.setVec3("light.specular", specularColour);
-	blockShader.setVec3("light.direction", lightDir);
+void draw(Shader& blockShader)
+{
+	blockShader.use();
+
+	glm::ivec3 playerChunk = gPlayer->getChunkCoords();
 
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	PROFILE_GPU_SCOPE("world");
 	gWorld->draw(blockShader, playerChunk);
 }
 
 void drawBlockOutline(vec3 coords) {
+	PROFILE_SCOPE("outline");
+	PROFILE_GPU_SCOPE("outline");
 	static unsigned int VAO = 0, VBO = 0;
 	if (VAO == 0) {
 
@@ -201,7 +335,7 @@ void drawBlockOutline(vec3 coords) {
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(Block::cubeVertices), Block::cubeVertices, GL_STATIC_DRAW);
 
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
 		glEnableVertexAttribArray(0);
 
 		std::cout << "Outline VAO/VBO:" << VAO << ", " << VBO << "\n";
@@ -209,31 +343,28 @@ void drawBlockOutline(vec3 coords) {
 	glBindVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-	static Shader outlineShader("chunk-generator/shader.vs", "chunk-generator/outline.fs");
+	static Shader outlineShader = loadShader("chunk-generator/shader.vs", "chunk-generator/outline.fs");
 	outlineShader.use();
 
 	mat4 model(1.0f);
 	model = glm::translate(model, coords);
 	model = glm::scale(model, vec3(1.1));
 
-	mat4 view = gPlayer->camera.GetViewMatrix();
-	static mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / (float)HEIGHT, 0.1f, (float)RENDER_DISTANCE * std::max(CHUNK_MAX_X, CHUNK_MAX_Z));
-
 	outlineShader.setMat4("model", model);
-	outlineShader.setMat4("view", view);
-	outlineShader.setMat4("projection", projection);
 
 	glDrawArrays(GL_TRIANGLES, 0, 36);
 	glBindVertexArray(0);
 }
 
 void drawCursor() {
+	PROFILE_SCOPE("cursor");
+	PROFILE_GPU_SCOPE("cursor");
 	static float crosshairVerts[] = {
 	-0.02f,  0.0f,   0.02f, 0.0f,   
 	 0.0f, -0.02f,   0.0f, 0.02f,  
 	};
 
-	static Shader crosshairShader("chunk-generator/cursor.vs", "chunk-generator/outline.fs");
+	static Shader crosshairShader = loadShader("chunk-generator/cursor.vs", "chunk-generator/outline.fs");
 	crosshairShader.use();
 
 	static unsigned int VAO = 0, VBO = 0;
@@ -258,30 +389,153 @@ void drawCursor() {
 
 void Block::BlockRegistry::testRegister() {
 	using namespace Block;
+	int grass = registerTexture("grass.png");
+
 	registerBlock({ "Air", {0, 0, 0, 0, 0, 0}, {BlockTag::Air, BlockTag::Transparent} });
-	registerBlock({ "Grass", {1, 1, 1, 1, 1, 1}, {} });
+	registerBlock({ "Grass", {grass, grass, grass, grass, grass, grass}, {} });
+	registerBlock({ "Lamp", {grass, grass, grass, grass, grass, grass}, {}, 14 });
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+	using Clock = std::chrono::steady_clock;
+	const auto launchTime = Clock::now();
+	auto millisSinceLaunch = [&launchTime]() {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - launchTime).count();
+	};
+
+	bool useDensityTerrain = false;
+	bool blockingStartup = false;
+	bool headless = false;
+	bool serve = false;
+	bool connect = false;
+	bool persistEdits = true;
+	uint16_t port = DEFAULT_PORT;
+	std::string recordPath;
+	std::optional<Recording> replay;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bench" && i + 1 < argc) {
+			Block::BlockRegistry::getInstance().testRegister();
+			return Bench::run(argv[++i]);
+		}
+		else if (arg == "--density") {
+			useDensityTerrain = true;
+		}
+		else if (arg == "--blocking-startup") {
+			blockingStartup = true;
+		}
+		else if (arg == "--record" && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc) {
+			replay = Recording::load(argv[++i]);
+			if (!replay) return 1;
+		}
+		else if (arg == "--headless") {
+			headless = true;
+		}
+		else if (arg == "--serve") {
+			serve = true;
+		}
+		else if (arg == "--connect") {
+			connect = true;
+		}
+		else if (arg == "--no-save") {
+			persistEdits = false;
+		}
+		else if (arg == "--port" && i + 1 < argc) {
+			const char* value = argv[++i];
+			const char* end = value + std::char_traits<char>::length(value);
+			int parsed = 0;
+			auto [rest, error] = std::from_chars(value, end, parsed);
+			if (error != std::errc() || rest != end || parsed < 1 || parsed > 65535) {
+				std::cout << "--port needs a number from 1 to 65535" << std::endl;
+				return 1;
+			}
+			port = static_cast<uint16_t>(parsed);
+		}
+		else {
+			std::cout << "Unknown option " << arg << std::endl;
+		}
+	}
+
+	if (headless && !replay) {
+		std::cout << "--headless needs a recording to --replay" << std::endl;
+		return 1;
+	}
+
+	// recordings start from untouched terrain, so they replay the same anywhere
+	if (replay || !recordPath.empty()) persistEdits = false;
+
+	uint32_t seed = 0;
+	if (replay) {
+		seed = replay->seed;
+		useDensityTerrain = replay->densityTerrain;
+		replaying = true;
+	}
+
+	// a server never opens a window, it generates and edits chunks for whoever connects
+	if (serve) {
+		ChunkServer server(seed, useDensityTerrain, persistEdits);
+		if (!server.listen(port)) return 1;
+
+		std::signal(SIGINT, requestServerStop);
+		std::signal(SIGTERM, requestServerStop);
+
+		auto lastStats = Clock::now();
+		while (!stopServing) {
+			server.step(50);
+			if (Clock::now() - lastStats > std::chrono::seconds(10)) {
+				server.printStats(std::cout);
+				lastStats = Clock::now();
+			}
+		}
+
+		std::cerr << "Stopping server" << std::endl;
+		server.compactJournal();
+		server.printStats(std::cout);
+		return 0;
+	}
+
+	std::optional<ChunkClient> client;
+	if (connect) {
+		std::optional<Net::Connection> connection = Net::Connection::connect(port);
+		if (!connection) return 1;
+		client.emplace(std::move(*connection));
+	}
+
+	Recording recording;
+	recording.seed = seed;
+	recording.densityTerrain = useDensityTerrain;
+	if (!recordPath.empty()) gRecording = &recording;
+
 	try {
-		initialize();
+		initialize(headless);
 	} catch (std::exception& e) {
 		std::cout << e.what() << std::endl;
 	}
 
 	Block::BlockRegistry::getInstance().testRegister();
-	Shader blockShader("chunk-generator/shader.vs", "chunk-generator/shader.fs");
+	Shader blockShader = loadShader("chunk-generator/shader.vs", "chunk-generator/shader.fs");
+	UniformBuffer frameUniforms(sizeof(FrameUniforms), FRAME_UNIFORMS_BINDING);
 
 	Player player{};
 
 	std::cerr << "Generating world..." << std::endl;
-	World world{0};
-	std::cerr << "World generated!" << std::endl;
+	std::unique_ptr<World> worldStorage = client
+		? std::make_unique<World>(*client)
+		: std::make_unique<World>(seed, useDensityTerrain, blockingStartup, persistEdits);
+	World& world = *worldStorage;
+	std::cerr << "World generated in " << millisSinceLaunch() << "ms" << std::endl;
 	gPlayer = &player;
 	gWorld = &world;
 	gPlayer->camera.MovementSpeed = 25.0f;
 	
-	unsigned int dirtTex = loadTexture("grass.png");
+	unsigned int blockTextures = loadBlockTextures();
+	uploadFaceLayers(blockShader);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextures);
 
 	std::cout << "World size:" << sizeof(World) << std::endl;
 	std::cout << "Chunk size:" << sizeof(Chunk) << std::endl;
@@ -292,12 +546,42 @@ int main() {
 
 	glm::vec3 lightColour(1.0f, 1.0f, 0.0f);
 
+	Profiler& profiler = Profiler::getInstance();
+
+	// startup is judged by when something is on screen and when the whole view distance is
+	bool firstFrameShown = false;
+	bool fullViewLoaded = false;
+
+	glm::vec3 lastPosition = player.camera.Position;
+
+	// replays run unthrottled, one recorded tick per frame
+	size_t replayTick = 0, replayEdit = 0;
+	ReplayStats replayStats;
+	if (replay) glfwSwapInterval(0);
+
 	while (!glfwWindowShouldClose(window)) {
+		if (replay && replayTick == replay->ticks.size()) break;
+		if (client && !client->isConnected()) {
+			std::cout << "Lost connection to the chunk server" << std::endl;
+			break;
+		}
+
+		const auto frameStart = Clock::now();
+		profiler.beginFrame();
+		Uploader::getInstance().beginFrame();
+
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
-		process_input(window);
+		if (replay) {
+			deltaTime = REPLAY_TIMESTEP;
+			apply_replay_tick(*replay, replayTick++, replayEdit);
+		}
+		else {
+			process_input(window);
+		}
+		if (gRecording) gRecording->addTick(player.camera);
 		
 		glm::vec4 skyColour(0.3, 0.75, 0.85, 1.0); // shade of blue
 		skyColour *= glm::dot(glm::normalize(glm::vec3(cos(glfwGetTime() / 2.0f), 0.2f, sin(glfwGetTime() / 2.0f))), {0, 1, 0});
@@ -305,17 +589,64 @@ int main() {
 		glClearColor(skyColour.r, skyColour.g, skyColour.b, skyColour.a);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		world.update();
+		// the load queue favours what is on screen and where the player is heading
+		Viewer viewer;
+		viewer.position = player.camera.Position;
+		viewer.front = player.camera.Front;
+		if (deltaTime > 0.0f) viewer.velocity = (player.camera.Position - lastPosition) / deltaTime;
+		viewer.frustum = Frustum(projectionMatrix() * player.camera.GetViewMatrix());
+		lastPosition = player.camera.Position;
+		world.setViewer(viewer);
+
+		world.update(CHUNK_BUDGET_MICROS);
+
+		bool selected;
+		if (headless) {
+			// everything up to issuing draw calls
+			world.cull(player.getChunkCoords());
+			PROFILE_SCOPE("selectBlock");
+			selected = player.selectBlock(world);
+		}
+		else {
+			updateFrameUniforms(frameUniforms, lightColour);
+			draw(blockShader);
+
+			{
+				PROFILE_SCOPE("selectBlock");
+				selected = player.selectBlock(world);
+			}
+			if (selected) {
+				drawBlockOutline(player.getSelected().coords);
+			}
+			drawCursor();
+
+			{
+				PROFILE_SCOPE("swap");
+				glfwSwapBuffers(window);
+			}
+		}
+		glfwPollEvents();
 
-		draw(blockShader, lightColour);
-		if (player.selectBlock(world)) {
-			drawBlockOutline(player.getSelected().coords);
+		if (!firstFrameShown) {
+			firstFrameShown = true;
+			std::cerr << "Time to first frame: " << millisSinceLaunch() << "ms" << std::endl;
+		}
+		if (!fullViewLoaded && !world.hasPendingWork()) {
+			fullViewLoaded = true;
+			std::cerr << "Time to full view distance: " << millisSinceLaunch() << "ms" << std::endl;
 		}
-		drawCursor();
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		profiler.endFrame();
+		if (replay) replayStats.addFrame(std::chrono::duration<float, std::milli>(Clock::now() - frameStart).count());
+	}
+
+	profiler.printSummary(std::cout);
+	if (replay) {
+		replayStats.print(std::cout);
+		world.printStats(std::cout);
 	}
+	if (gRecording) gRecording->save(recordPath);
+	world.memoryReport().dumpJson("memory.json");
 	
 	glfwTerminate();
 	return 0;
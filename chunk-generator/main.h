@@ -1,3 +1,3 @@
 #pragma once
 
-void draw(Shader& blockShader, glm::vec3& lightColour);
+void draw(Shader& blockShader);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+/*
+Named totals grouped by subsystem, counts and bytes of what is held right now
+Built on demand by walking the world rather than tracked on every allocation, so it costs nothing until asked for
+Names ending in "Bytes" are in bytes, everything else is a count. Some totals are part of others, like a
+mesh's size and its capacity, so they aren't summed
+*/
+class MemoryReport
+{
+public:
+	inline void add(const std::string& group, const std::string& name, uint64_t value) {
+		groups[group][name] += value;
+	}
+
+	// 0 if nothing was reported under that name
+	inline uint64_t get(const std::string& group, const std::string& name) const {
+		auto entries = groups.find(group);
+		if (entries == groups.end()) return 0;
+		auto entry = entries->second.find(name);
+		return entry == entries->second.end() ? 0 : entry->second;
+	}
+
+	inline void print(std::ostream& os) const {
+		os << "Memory:\n";
+		for (const auto& [group, entries] : groups) {
+			os << "  " << group << ":";
+			for (const auto& [name, value] : entries) {
+				if (isBytes(name)) os << " " << name << " " << value / 1024 << "KB";
+				else os << " " << name << " " << value;
+			}
+			os << "\n";
+		}
+	}
+
+	// {"group": {"name": value, ...}, ...}, keys sorted so dumps diff cleanly
+	inline bool dumpJson(const std::string& path) const {
+		std::ofstream file(path);
+		if (!file) {
+			std::cout << "ERR :: COULD NOT WRITE MEMORY REPORT TO " << path << std::endl;
+			return false;
+		}
+
+		file << "{";
+		const char* groupSeparator = "\n";
+		for (const auto& [group, entries] : groups) {
+			file << groupSeparator << "\t\"" << group << "\": {";
+			const char* separator = "\n";
+			for (const auto& [name, value] : entries) {
+				file << separator << "\t\t\"" << name << "\": " << value;
+				separator = ",\n";
+			}
+			file << "\n\t}";
+			groupSeparator = ",\n";
+		}
+		file << "\n}\n";
+
+		std::cerr << "Wrote memory report to " << path << std::endl;
+		return true;
+	}
+
+private:
+	std::map<std::string, std::map<std::string, uint64_t>> groups;
+
+	static inline bool isBytes(const std::string& name) {
+		return name.size() >= 5 && name.compare(name.size() - 5, 5, "Bytes") == 0;
+	}
+};
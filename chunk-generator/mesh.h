@@ -13,6 +13,10 @@ struct Vertex
 	glm::vec3 coords;
 	glm::vec3 normal;
 	glm::vec2 texCoords;
+	// the shader turns these into a texture array layer
+	uint8_t blockType = 0;
+	uint8_t face = 0; // cubeVertices order
+	uint8_t light = 0; // of the cell the face looks into, sky in the high nibble and block light in the low
 };
 
 struct Vertex2
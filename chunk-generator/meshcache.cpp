@@ -0,0 +1,226 @@
+#include "meshcache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+
+#include "profiler.h"
+
+MeshCache::MeshCache(std::string directory, uint64_t maxBytes) : directory(std::move(directory)), maxBytes(maxBytes) {
+	std::error_code error;
+	std::filesystem::create_directories(this->directory, error);
+	if (error) {
+		std::cout << "ERR :: COULD NOT CREATE MESH CACHE AT " << this->directory << ": " << error.message() << std::endl;
+		writable = false;
+		return;
+	}
+
+	scanDirectory();
+	writer = std::thread(&MeshCache::writeLoop, this);
+}
+
+MeshCache::~MeshCache() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	writeQueued.notify_one();
+	if (writer.joinable()) writer.join();
+}
+
+void MeshCache::scanDirectory() {
+	struct Found {
+		uint64_t hash;
+		uint64_t bytes;
+		std::filesystem::file_time_type modified;
+	};
+	vector<Found> found;
+
+	std::error_code error;
+	for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+		const std::filesystem::path& path = file.path();
+		if (path.extension() != ".mesh") {
+			// a write cut short by a crash
+			if (path.extension() == ".tmp") std::filesystem::remove(path, error);
+			continue;
+		}
+
+		const std::string stem = path.stem().string();
+		char* end = nullptr;
+		uint64_t hash = std::strtoull(stem.c_str(), &end, 16);
+		if (stem.size() != 16 || *end != '\0') continue;
+
+		uint64_t bytes = file.file_size(error);
+		if (error) continue;
+		found.push_back({ hash, bytes, file.last_write_time(error) });
+	}
+
+	std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.modified < b.modified; });
+	for (const Found& file : found) {
+		recent.push_front(file.hash);
+		entries[file.hash] = { file.bytes, recent.begin() };
+		stats.bytesOnDisk += file.bytes;
+	}
+	evict();
+}
+
+uint64_t MeshCache::hashBytes(const void* data, size_t size, uint64_t hash) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+std::string MeshCache::pathFor(uint64_t hash) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(hash));
+	return directory + "/" + name;
+}
+
+bool MeshCache::load(uint64_t hash, vector<Vertex>& vertices) {
+	PROFILE_SCOPE("MeshCache::load");
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto entry = entries.find(hash);
+		if (entry == entries.end()) {
+			stats.misses++;
+			return false;
+		}
+		recent.splice(recent.begin(), recent, entry->second.recent);
+	}
+
+	// evicted since the lookup, or removed by hand, reads as a miss
+	FILE* file = std::fopen(pathFor(hash).c_str(), "rb");
+	if (!file) {
+		std::lock_guard<std::mutex> lock(mutex);
+		stats.misses++;
+		return false;
+	}
+
+	// a file from another mesher or Vertex layout counts as a miss and gets overwritten
+	Header header{};
+	bool valid = std::fread(&header, sizeof(header), 1, file) == 1
+		&& header.magic == MAGIC && header.version == MESHER_VERSION && header.vertexSize == sizeof(Vertex);
+
+	if (valid) {
+		vertices.resize(header.vertexCount);
+		valid = std::fread(vertices.data(), sizeof(Vertex), header.vertexCount, file) == header.vertexCount;
+		if (!valid) vertices.clear();
+	}
+	std::fclose(file);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!valid) {
+		stats.misses++;
+		return false;
+	}
+
+	stats.hits++;
+	stats.bytesRead += sizeof(header) + sizeof(Vertex) * header.vertexCount;
+	return true;
+}
+
+void MeshCache::store(uint64_t hash, const vector<Vertex>& vertices) {
+	PROFILE_SCOPE("MeshCache::store");
+	if (!writable) return;
+
+	const uint64_t bytes = sizeof(Vertex) * vertices.size();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// the disk can't keep up, the chunk is simply meshed again next time
+		if (pendingBytes + bytes > MAX_PENDING_BYTES) {
+			stats.dropped++;
+			return;
+		}
+		pending.push_back({ hash, vertices });
+		pendingBytes += bytes;
+	}
+	writeQueued.notify_one();
+}
+
+void MeshCache::flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	writesDone.wait(lock, [this]() { return pending.empty() && !writing; });
+}
+
+void MeshCache::writeLoop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		writeQueued.wait(lock, [this]() { return stopping || !pending.empty(); });
+		if (pending.empty()) return;
+
+		PendingWrite write = std::move(pending.front());
+		pending.pop_front();
+		pendingBytes -= sizeof(Vertex) * write.vertices.size();
+		writing = true;
+
+		lock.unlock();
+		const bool written = writeFile(write.hash, write.vertices);
+		lock.lock();
+
+		writing = false;
+		if (written) {
+			const uint64_t bytes = sizeof(Header) + sizeof(Vertex) * write.vertices.size();
+			auto entry = entries.find(write.hash);
+			if (entry != entries.end()) {
+				stats.bytesOnDisk -= entry->second.bytes;
+				recent.erase(entry->second.recent);
+			}
+			recent.push_front(write.hash);
+			entries[write.hash] = { bytes, recent.begin() };
+			stats.bytesOnDisk += bytes;
+			stats.writes++;
+			evict();
+		}
+		if (pending.empty()) writesDone.notify_all();
+	}
+}
+
+bool MeshCache::writeFile(uint64_t hash, const vector<Vertex>& vertices) const {
+	// written under a temporary name so a crash never leaves a truncated entry behind
+	std::string path = pathFor(hash);
+	std::string tempPath = path + ".tmp";
+
+	FILE* file = std::fopen(tempPath.c_str(), "wb");
+	if (!file) return false;
+
+	Header header{ MAGIC, MESHER_VERSION, sizeof(Vertex), static_cast<uint32_t>(vertices.size()) };
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(vertices.data(), sizeof(Vertex), vertices.size(), file) == vertices.size();
+	written = std::fclose(file) == 0 && written;
+
+	std::error_code error;
+	if (written) std::filesystem::rename(tempPath, path, error);
+	if (!written || error) {
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+	return true;
+}
+
+void MeshCache::evict() {
+	while (stats.bytesOnDisk > maxBytes && !recent.empty()) {
+		const uint64_t hash = recent.back();
+		recent.pop_back();
+
+		auto entry = entries.find(hash);
+		stats.bytesOnDisk -= entry->second.bytes;
+		entries.erase(entry);
+
+		std::error_code error;
+		std::filesystem::remove(pathFor(hash), error);
+		stats.evictions++;
+	}
+}
+
+void MeshCache::printStats(std::ostream& os) const {
+	Stats stats = getStats();
+	uint64_t lookups = stats.hits + stats.misses;
+	os << "Mesh cache: hit rate " << (lookups ? 100.0 * stats.hits / lookups : 0.0) << "% (" << stats.hits << "/" << lookups << "), "
+		<< stats.writes << " written, " << stats.dropped << " dropped, " << stats.evictions << " evicted, "
+		<< stats.bytesOnDisk / 1024 << "/" << maxBytes / 1024 << "KB on disk, " << stats.bytesRead / 1024 << "KB read\n";
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "mesh.h"
+
+using std::vector;
+
+/*
+On disk cache of chunk meshes
+A mesh only depends on the chunk's blocks and light, so it is keyed by a hash of them and
+identical chunks anywhere in the world share one file. Files hold a small header and the raw
+vertices, which are read straight into the chunk's vertex buffer with one read
+Stores are written by a thread of the cache's own, and the least recently used files are
+deleted once the directory holds more than its byte cap
+load and store can be called from several threads at once
+*/
+class MeshCache
+{
+public:
+	// bump whenever the mesher or Vertex changes, old files are then never hit again
+	static constexpr uint32_t MESHER_VERSION = 2;
+
+	static constexpr uint64_t DEFAULT_MAX_BYTES = 256ull << 20;
+
+	// stores arriving while this much is still waiting to be written are dropped
+	static constexpr uint64_t MAX_PENDING_BYTES = 16ull << 20;
+
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t writes = 0;
+		uint64_t dropped = 0;
+		uint64_t evictions = 0;
+		uint64_t bytesRead = 0;
+		uint64_t bytesOnDisk = 0;
+	};
+
+	// directory is created if it doesn't exist yet, files already in it count towards maxBytes
+	MeshCache(std::string directory, uint64_t maxBytes = DEFAULT_MAX_BYTES);
+
+	// writes whatever is still queued
+	~MeshCache();
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// FNV-1a seeded with MESHER_VERSION, pass the previous result as hash to cover more data
+	static constexpr uint64_t HASH_BASIS = 0xcbf29ce484222325ull ^ MESHER_VERSION;
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HASH_BASIS);
+
+	// false, leaving vertices untouched, when there is no valid entry for hash
+	bool load(uint64_t hash, vector<Vertex>& vertices);
+
+	// queues a copy of vertices for the writer thread, returns straight away
+	void store(uint64_t hash, const vector<Vertex>& vertices);
+
+	// blocks until every store so far is on disk
+	void flush();
+
+	inline Stats getStats() const {
+		std::lock_guard<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	void printStats(std::ostream& os) const;
+
+private:
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexSize;
+		uint32_t vertexCount;
+	};
+
+	static constexpr uint32_t MAGIC = 0x4853454D; // "MESH"
+
+	struct Entry {
+		uint64_t bytes;
+		std::list<uint64_t>::iterator recent;
+	};
+
+	struct PendingWrite {
+		uint64_t hash;
+		vector<Vertex> vertices;
+	};
+
+	std::string directory;
+	uint64_t maxBytes;
+	bool writable = true;
+
+	// everything below is guarded by mutex
+	mutable std::mutex mutex;
+	Stats stats;
+
+	// the files in directory, recent has the most recently used hash at the front
+	std::unordered_map<uint64_t, Entry> entries;
+	std::list<uint64_t> recent;
+
+	std::deque<PendingWrite> pending;
+	uint64_t pendingBytes = 0;
+	bool writing = false;
+	bool stopping = false;
+	std::condition_variable writeQueued;
+	std::condition_variable writesDone;
+
+	std::thread writer;
+
+	std::string pathFor(uint64_t hash) const;
+
+	// indexes the files a previous run left, oldest first
+	void scanDirectory();
+
+	void writeLoop();
+	bool writeFile(uint64_t hash, const vector<Vertex>& vertices) const;
+
+	// deletes least recently used files until the cache fits maxBytes, mutex must be held
+	void evict();
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+
+#include "block.h"
+
+/*
+Face culling shared by every block layout
+Faces are numbered like Block::cubeVertices: front (+z), back (-z), left (-x), right (+x), top (+y), bottom (-y)
+*/
+namespace Mesher {
+	constexpr int FACE_OFFSETS[6][3] = {
+		{ 0, 0, 1 }, { 0, 0, -1 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 },
+	};
+
+	// cell u, v of the side of a SIZE cube facing face, u and v run along the side's axes in x, y, z order
+	template <int SIZE>
+	inline glm::ivec3 sideCell(int face, int u, int v) {
+		const int axis = face < 2 ? 2 : face < 4 ? 0 : 1;
+		const int at = FACE_OFFSETS[face][axis] > 0 ? SIZE - 1 : 0;
+		switch (axis) {
+			case 0: return { at, u, v };
+			case 1: return { u, at, v };
+			default: return { u, v, at };
+		}
+	}
+
+	// per block type flags, looked up once per mesh instead of through the registry per neighbour
+	struct TagTable {
+		std::array<bool, 256> air{};
+		std::array<bool, 256> transparent{};
+
+		TagTable() {
+			using namespace Block;
+			const BlockRegistry& registry = BlockRegistry::getInstance();
+			for (size_t type = 0; type < registry.size() && type < 256; type++) {
+				air[type] = registry.getDef(static_cast<BlockType>(type)).hasTag(BlockTag::Air);
+				transparent[type] = registry.getDef(static_cast<BlockType>(type)).hasTag(BlockTag::Transparent);
+			}
+		}
+	};
+
+	// calls emit(x, y, z, face) for every face of a solid block that touches a transparent one
+	// walks the storage in memory order, anything outside the storage counts as transparent
+	template <typename Storage, typename EmitFace>
+	void forEachVisibleFace(const Storage& storage, const TagTable& tags, EmitFace&& emit) {
+		Storage::Layout::forEach([&](int x, int y, int z) {
+			if (tags.air[storage.get(x, y, z)]) return;
+
+			for (int face = 0; face < 6; face++) {
+				int nx = x + FACE_OFFSETS[face][0];
+				int ny = y + FACE_OFFSETS[face][1];
+				int nz = z + FACE_OFFSETS[face][2];
+				if (!Storage::inBounds(nx, ny, nz) || tags.transparent[storage.get(nx, ny, nz)])
+					emit(x, y, z, face);
+			}
+		});
+	}
+
+	// the faces forEachVisibleFace finds in terrain solid from the bottom up to heights.height(x, z),
+	// without visiting the blocks, solid blocks must be opaque and the rest air
+	template <int SX, int SZ, typename Heights, typename EmitFace>
+	void forEachColumnFace(const Heights& heights, EmitFace&& emit) {
+		for (int z = 0; z < SZ; z++) {
+			for (int x = 0; x < SX; x++) {
+				const int height = heights.height(x, z);
+				if (height == 0) continue;
+
+				emit(x, height - 1, z, 4);
+				emit(x, 0, z, 5);
+
+				// sides show wherever the column next to it is shorter, all of it along the chunk's border
+				for (int face = 0; face < 4; face++) {
+					int nx = x + FACE_OFFSETS[face][0];
+					int nz = z + FACE_OFFSETS[face][2];
+					int covered = nx >= 0 && nx < SX && nz >= 0 && nz < SZ ? heights.height(nx, nz) : 0;
+					for (int y = covered; y < height; y++) emit(x, y, z, face);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,290 @@
+#include "net.h"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+
+using ssize_t = int;
+static constexpr SocketHandle NO_SOCKET = INVALID_SOCKET;
+
+static inline void closeSocket(SocketHandle socket) {
+	closesocket(socket);
+}
+
+static inline void setNonBlocking(SocketHandle socket) {
+	u_long enabled = 1;
+	ioctlsocket(socket, FIONBIO, &enabled);
+}
+
+static inline bool wouldBlock() {
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+}
+
+static inline int pollSockets(pollfd* fds, size_t count, int timeoutMillis) {
+	return WSAPoll(fds, static_cast<ULONG>(count), timeoutMillis);
+}
+
+// winsock never raises signals
+static constexpr int SEND_FLAGS = 0;
+
+// winsock has to be started before the first socket call
+static void startSockets() {
+	static bool started = false;
+	if (started) return;
+	WSADATA data;
+	WSAStartup(MAKEWORD(2, 2), &data);
+	started = true;
+}
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr SocketHandle NO_SOCKET = -1;
+
+static inline void closeSocket(SocketHandle socket) {
+	close(socket);
+}
+
+static inline void setNonBlocking(SocketHandle socket) {
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+}
+
+static inline bool wouldBlock() {
+	return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+static inline int pollSockets(pollfd* fds, size_t count, int timeoutMillis) {
+	return poll(fds, count, timeoutMillis);
+}
+
+// writing to a socket whose peer is gone raises SIGPIPE, which would kill --serve when a client quits
+// sends ask not to where they can, elsewhere the signal is ignored for the whole process once
+#ifdef MSG_NOSIGNAL
+static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+
+static void startSockets() {}
+#else
+static constexpr int SEND_FLAGS = 0;
+
+static void startSockets() {
+	static bool started = false;
+	if (started) return;
+	std::signal(SIGPIPE, SIG_IGN);
+	started = true;
+}
+#endif
+#endif
+
+namespace Net {
+	namespace {
+		// length and type in front of every payload
+		constexpr size_t HEADER_BYTES = 5;
+
+		// messages bigger than this mean the stream is corrupt, a chunk is at most a few hundred KB
+		constexpr uint32_t MAX_MESSAGE_BYTES = 16 << 20;
+
+		constexpr size_t RECEIVE_CHUNK_BYTES = 64 * 1024;
+
+		sockaddr_in loopback(uint16_t port) {
+			sockaddr_in address{};
+			address.sin_family = AF_INET;
+			address.sin_port = htons(port);
+			address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			return address;
+		}
+
+		// kernel buffers per direction, left to grow on their own loopback ones reach megabytes
+		// and hide a client that stopped reading from the server's high water mark
+		constexpr int SOCKET_BUFFER_BYTES = 128 * 1024;
+
+		void configure(SocketHandle socket) {
+			// deltas are tiny and latency matters more than packet count
+			int enabled = 1;
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enabled), sizeof(enabled));
+
+			int bytes = SOCKET_BUFFER_BYTES;
+			setsockopt(socket, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+			setsockopt(socket, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+		}
+	}
+
+	std::optional<Connection> Connection::connect(uint16_t port) {
+		startSockets();
+		SocketHandle socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (socket == NO_SOCKET) return std::nullopt;
+
+		// connected while still blocking, loopback answers straight away
+		sockaddr_in address = loopback(port);
+		if (::connect(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+			std::cout << "ERR :: COULD NOT CONNECT TO PORT " << port << std::endl;
+			closeSocket(socket);
+			return std::nullopt;
+		}
+		return Connection(socket);
+	}
+
+	Connection::Connection(SocketHandle socket) : socket(socket) {
+		setNonBlocking(socket);
+		configure(socket);
+	}
+
+	Connection::~Connection() {
+		if (socket != NO_SOCKET) closeSocket(socket);
+	}
+
+	Connection::Connection(Connection&& other) noexcept : bytesSent(other.bytesSent), bytesReceived(other.bytesReceived),
+		socket(other.socket), open(other.open), outgoing(std::move(other.outgoing)), sentOffset(other.sentOffset),
+		incoming(std::move(other.incoming)), readOffset(other.readOffset) {
+		other.socket = NO_SOCKET;
+		other.open = false;
+	}
+
+	Connection& Connection::operator=(Connection&& other) noexcept {
+		if (this == &other) return *this;
+		if (socket != NO_SOCKET) closeSocket(socket);
+		socket = other.socket;
+		open = other.open;
+		bytesSent = other.bytesSent;
+		bytesReceived = other.bytesReceived;
+		outgoing = std::move(other.outgoing);
+		sentOffset = other.sentOffset;
+		incoming = std::move(other.incoming);
+		readOffset = other.readOffset;
+		other.socket = NO_SOCKET;
+		other.open = false;
+		return *this;
+	}
+
+	void Connection::send(MessageType type, const vector<uint8_t>& payload) {
+		Writer writer(outgoing);
+		writer.put<uint32_t>(static_cast<uint32_t>(payload.size()));
+		writer.put<uint8_t>(static_cast<uint8_t>(type));
+		outgoing.insert(outgoing.end(), payload.begin(), payload.end());
+	}
+
+	bool Connection::flush() {
+		while (open && sentOffset < outgoing.size()) {
+			ssize_t sent = ::send(socket, reinterpret_cast<const char*>(outgoing.data() + sentOffset),
+				static_cast<int>(outgoing.size() - sentOffset), SEND_FLAGS);
+			if (sent < 0) {
+				// a broken pipe or reset (EPIPE, ECONNRESET) is the peer gone, like any other failure
+				if (!wouldBlock()) open = false;
+				break;
+			}
+			sentOffset += sent;
+			bytesSent += sent;
+		}
+
+		// the written front is dropped once it outweighs what is left, so the buffer doesn't grow forever
+		if (sentOffset == outgoing.size()) {
+			outgoing.clear();
+			sentOffset = 0;
+		}
+		else if (sentOffset > outgoing.size() / 2) {
+			outgoing.erase(outgoing.begin(), outgoing.begin() + sentOffset);
+			sentOffset = 0;
+		}
+		return open;
+	}
+
+	bool Connection::receive() {
+		while (open) {
+			size_t size = incoming.size();
+			incoming.resize(size + RECEIVE_CHUNK_BYTES);
+			ssize_t received = recv(socket, reinterpret_cast<char*>(incoming.data() + size), static_cast<int>(RECEIVE_CHUNK_BYTES), 0);
+			incoming.resize(size + std::max<ssize_t>(received, 0));
+
+			if (received == 0) open = false;
+			else if (received < 0) {
+				if (!wouldBlock()) open = false;
+				break;
+			}
+			else bytesReceived += received;
+		}
+		return open;
+	}
+
+	std::optional<Message> Connection::next() {
+		if (incoming.size() - readOffset < HEADER_BYTES) return std::nullopt;
+
+		vector<uint8_t> header(incoming.begin() + readOffset, incoming.begin() + readOffset + HEADER_BYTES);
+		Reader reader(header);
+		uint32_t size = reader.get<uint32_t>();
+		MessageType type = static_cast<MessageType>(reader.get<uint8_t>());
+		if (size > MAX_MESSAGE_BYTES) {
+			std::cout << "ERR :: MESSAGE OF " << size << " BYTES, CLOSING CONNECTION" << std::endl;
+			open = false;
+			return std::nullopt;
+		}
+		if (incoming.size() - readOffset - HEADER_BYTES < size) return std::nullopt;
+
+		auto begin = incoming.begin() + readOffset + HEADER_BYTES;
+		Message message{ type, vector<uint8_t>(begin, begin + size) };
+		readOffset += HEADER_BYTES + size;
+
+		if (readOffset == incoming.size()) {
+			incoming.clear();
+			readOffset = 0;
+		}
+		else if (readOffset > incoming.size() / 2) {
+			incoming.erase(incoming.begin(), incoming.begin() + readOffset);
+			readOffset = 0;
+		}
+		return message;
+	}
+
+	std::optional<Listener> Listener::listen(uint16_t port) {
+		startSockets();
+		SocketHandle socket = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (socket == NO_SOCKET) return std::nullopt;
+
+		// a restarted server can take the port back straight away
+		int reuse = 1;
+		setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+		sockaddr_in address = loopback(port);
+		if (bind(socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(socket, 8) != 0) {
+			std::cout << "ERR :: COULD NOT LISTEN ON PORT " << port << std::endl;
+			closeSocket(socket);
+			return std::nullopt;
+		}
+		setNonBlocking(socket);
+		return Listener(socket);
+	}
+
+	Listener::~Listener() {
+		if (socket != NO_SOCKET) closeSocket(socket);
+	}
+
+	Listener::Listener(Listener&& other) noexcept : socket(other.socket) {
+		other.socket = NO_SOCKET;
+	}
+
+	std::optional<Connection> Listener::accept() {
+		SocketHandle client = ::accept(socket, nullptr, nullptr);
+		if (client == NO_SOCKET) return std::nullopt;
+		return Connection(client);
+	}
+
+	void wait(const vector<std::pair<SocketHandle, bool>>& sockets, int timeoutMillis) {
+		vector<pollfd> fds;
+		fds.reserve(sockets.size());
+		for (const auto& [socket, wantWrite] : sockets) {
+			pollfd fd{};
+			fd.fd = socket;
+			fd.events = POLLIN | (wantWrite ? POLLOUT : 0);
+			fds.push_back(fd);
+		}
+		pollSockets(fds.data(), fds.size(), timeoutMillis);
+	}
+}
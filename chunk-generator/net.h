@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+using SocketHandle = SOCKET;
+#else
+using SocketHandle = int;
+#endif
+
+using std::vector;
+
+// where --serve listens and --connect looks, always on the loopback interface
+static constexpr uint16_t DEFAULT_PORT = 27015;
+
+/*
+Framed messages over non blocking TCP, for the chunk server and its clients
+Every message is a 4 byte length, a 1 byte type and the payload, all integers little endian.
+Sends queue into an outgoing buffer that flush drains as far as the socket takes, receives
+append to an incoming buffer that whole messages are cut from, so neither side ever waits on the other
+*/
+namespace Net {
+	enum class MessageType : uint8_t {
+		SUBSCRIBE, // client, centre chunk and radius of the square of chunks it wants
+		EDIT, // client, world position and block type, air removes
+		CHUNK, // server, chunk coords and run length encoded blocks
+		DELTA, // server, chunk coords and the blocks that changed in it
+	};
+
+	struct Message {
+		MessageType type;
+		vector<uint8_t> payload;
+	};
+
+	// appends little endian values to a payload
+	class Writer {
+	public:
+		explicit Writer(vector<uint8_t>& out) : out(out) {}
+
+		template <typename T>
+		inline void put(T value) {
+			auto bits = static_cast<std::make_unsigned_t<T>>(value);
+			for (size_t i = 0; i < sizeof(T); i++) out.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+		}
+
+		inline void putBytes(const vector<uint8_t>& bytes) {
+			put<uint32_t>(static_cast<uint32_t>(bytes.size()));
+			out.insert(out.end(), bytes.begin(), bytes.end());
+		}
+
+	private:
+		vector<uint8_t>& out;
+	};
+
+	// reads what Writer wrote, reading past the end zeroes the value and clears ok
+	class Reader {
+	public:
+		explicit Reader(const vector<uint8_t>& in) : in(in) {}
+
+		template <typename T>
+		inline T get() {
+			if (offset + sizeof(T) > in.size()) {
+				ok = false;
+				return T();
+			}
+			std::make_unsigned_t<T> bits = 0;
+			for (size_t i = 0; i < sizeof(T); i++) bits |= static_cast<std::make_unsigned_t<T>>(in[offset++]) << (8 * i);
+			return static_cast<T>(bits);
+		}
+
+		inline vector<uint8_t> getBytes() {
+			uint32_t size = get<uint32_t>();
+			if (!ok || offset + size > in.size()) {
+				ok = false;
+				return {};
+			}
+			vector<uint8_t> bytes(in.begin() + offset, in.begin() + offset + size);
+			offset += size;
+			return bytes;
+		}
+
+		bool ok = true;
+
+	private:
+		const vector<uint8_t>& in;
+		size_t offset = 0;
+	};
+
+	// one end of a TCP connection, closed on destruction
+	class Connection {
+	public:
+		// nothing if nobody is listening on port
+		static std::optional<Connection> connect(uint16_t port);
+
+		explicit Connection(SocketHandle socket);
+		~Connection();
+
+		Connection(Connection&& other) noexcept;
+		Connection& operator=(Connection&& other) noexcept;
+		Connection(const Connection&) = delete;
+		Connection& operator=(const Connection&) = delete;
+
+		// queues a message, nothing is written until flush
+		void send(MessageType type, const vector<uint8_t>& payload);
+
+		// writes as much of the queue as the socket takes, false once the peer is gone
+		bool flush();
+
+		// reads whatever has arrived, false once the peer is gone
+		bool receive();
+
+		// the oldest whole message received, nothing if the next one hasn't fully arrived
+		std::optional<Message> next();
+
+		// bytes queued but not yet taken by the socket
+		inline size_t pendingBytes() const {
+			return outgoing.size() - sentOffset;
+		}
+
+		inline bool isOpen() const {
+			return open;
+		}
+
+		inline SocketHandle handle() const {
+			return socket;
+		}
+
+		uint64_t bytesSent = 0;
+		uint64_t bytesReceived = 0;
+
+	private:
+		SocketHandle socket;
+		bool open = true;
+
+		vector<uint8_t> outgoing;
+		size_t sentOffset = 0; // outgoing before this has been written
+		vector<uint8_t> incoming;
+		size_t readOffset = 0; // incoming before this has been cut into messages
+	};
+
+	// accepts connections on a loopback port
+	class Listener {
+	public:
+		// nothing if the port is taken
+		static std::optional<Listener> listen(uint16_t port);
+
+		explicit Listener(SocketHandle socket) : socket(socket) {}
+		~Listener();
+
+		Listener(Listener&& other) noexcept;
+		Listener(const Listener&) = delete;
+		Listener& operator=(const Listener&) = delete;
+
+		// the next waiting connection, nothing if there is none
+		std::optional<Connection> accept();
+
+		inline SocketHandle handle() const {
+			return socket;
+		}
+
+	private:
+		SocketHandle socket;
+	};
+
+	// blocks until one of the sockets can be read, or written for those paired with true, or timeoutMillis passes
+	void wait(const vector<std::pair<SocketHandle, bool>>& sockets, int timeoutMillis);
+}
@@ -0,0 +1,275 @@
+#include "noise.h"
+
+#include <chrono>
+#include <utility>
+
+#include "profiler.h"
+
+namespace Noise {
+	vec2 gradient(uint32_t seed, int x, int z) {
+		// Hash to 32-bit
+		seed ^= static_cast<uint32_t>(x) * 0x9E3779B1u;
+		seed ^= static_cast<uint32_t>(z) * 0x85EBCA77u;
+		seed ^= (seed >> 16);
+		seed *= 0x27D4EB2Du;
+		seed ^= (seed >> 15);
+
+		// Convert to [0,1)
+		float normalized = static_cast<float>(seed) / static_cast<float>(UINT32_MAX);
+
+		// Map to [0, 2pi)
+		float angle = normalized * 2.0f * glm::pi<float>();
+
+		// Convert to unit vector
+		return glm::vec2(std::cos(angle), std::sin(angle));
+	}
+
+	namespace {
+		// the gradients of every lattice point columns from (minX, minZ) to (maxX, maxZ) can touch
+		class Lattice {
+		public:
+			Lattice(uint32_t seed, float scale, int minX, int minZ, int maxX, int maxZ)
+				: x(static_cast<int>(floor(scale * minX))), z(static_cast<int>(floor(scale * minZ))) {
+				width = static_cast<int>(floor(scale * maxX)) - x + 2;
+				const int depth = static_cast<int>(floor(scale * maxZ)) - z + 2;
+
+				gradients.resize(width * depth);
+				for (int j = 0; j < depth; j++) {
+					for (int i = 0; i < width; i++) {
+						gradients[i + width * j] = gradient(seed, x + i, z + j);
+					}
+				}
+			}
+
+			// samplePoint is already scaled by frequency
+			inline float sample(vec2 samplePoint) const {
+				// get the four corners
+				int x0 = static_cast<int>(floor(samplePoint.x));
+				int x1 = x0 + 1;
+				int z0 = static_cast<int>(floor(samplePoint.y));
+				int z1 = z0 + 1;
+
+				/*	ul   ur
+					 +---+    ^ z
+					 |   |    |
+					 +---+     --> x
+					bl   br  */
+
+				const vec2* row0 = &gradients[(x0 - x) + width * (z0 - z)];
+				const vec2* row1 = row0 + width;
+
+				// find the dot product between its displacement between corners and random vectors
+				float bl = glm::dot(samplePoint - vec2(x0, z0), row0[0]);
+				float br = glm::dot(samplePoint - vec2(x1, z0), row0[1]);
+				float ul = glm::dot(samplePoint - vec2(x0, z1), row1[0]);
+				float ur = glm::dot(samplePoint - vec2(x1, z1), row1[1]);
+
+				// compute smooth interpolation factors for x and y
+				float tx = glm::smoothstep(0.0f, 1.0f, glm::fract(samplePoint.x));
+				float ty = glm::smoothstep(0.0f, 1.0f, glm::fract(samplePoint.y));
+
+				// interpolate between them
+				float blerp = glm::mix(bl, br, tx);
+				float ulerp = glm::mix(ul, ur, tx);
+
+				return glm::mix(blerp, ulerp, ty);
+			}
+
+		private:
+			int x, z;
+			int width;
+			vector<vec2> gradients;
+		};
+	}
+
+	void perlin(uint32_t seed, float frequency, float amplitude,
+		int originX, int originZ, int width, int depth, vector<int>& offsets, int stride) {
+		const float scale = 1.0f / frequency;
+
+		if (stride <= 1) {
+			const Lattice lattice(seed, scale, originX, originZ, originX + width - 1, originZ + depth - 1);
+			for (int z = 0; z < depth; z++) {
+				for (int x = 0; x < width; x++) {
+					int heightOffset = lattice.sample(scale * vec2(originX + x, originZ + z)) * amplitude;
+					offsets[x + width * z] += heightOffset;
+				}
+			}
+			return;
+		}
+
+		// every stride-th column plus one past the end, so every column has a sample either side
+		const int coarseWidth = (width - 1) / stride + 2;
+		const int coarseDepth = (depth - 1) / stride + 2;
+		const Lattice lattice(seed, scale, originX, originZ, originX + (coarseWidth - 1) * stride, originZ + (coarseDepth - 1) * stride);
+
+		// which coarse sample is left of each column and how far along it is
+		vector<int> left(width);
+		vector<float> weight(width);
+		for (int x = 0; x < width; x++) {
+			left[x] = x / stride;
+			weight[x] = static_cast<float>(x % stride) / stride;
+		}
+
+		// each coarse row sampled and then widened to full width, so the pass over columns below
+		// only blends two contiguous rows, which compilers vectorize
+		vector<float> rows(coarseDepth * width);
+		vector<float> coarse(coarseWidth);
+		for (int j = 0; j < coarseDepth; j++) {
+			for (int i = 0; i < coarseWidth; i++) {
+				coarse[i] = lattice.sample(scale * vec2(originX + i * stride, originZ + j * stride));
+			}
+
+			float* row = &rows[width * j];
+			for (int x = 0; x < width; x++) {
+				row[x] = glm::mix(coarse[left[x]], coarse[left[x] + 1], weight[x]);
+			}
+		}
+
+		for (int z = 0; z < depth; z++) {
+			const float* row0 = &rows[width * (z / stride)];
+			const float* row1 = row0 + width;
+			const float t = static_cast<float>(z % stride) / stride;
+			int* out = &offsets[width * z];
+
+			for (int x = 0; x < width; x++) {
+				out[x] += static_cast<int>(glm::mix(row0[x], row1[x], t) * amplitude);
+			}
+		}
+	}
+
+	namespace {
+		// one of the 12 cube edge directions, the usual choice for 3D perlin gradients
+		vec3 gradient3(uint32_t seed, int x, int y, int z) {
+			static const vec3 directions[12] = {
+				{1, 1, 0}, {-1, 1, 0}, {1, -1, 0}, {-1, -1, 0},
+				{1, 0, 1}, {-1, 0, 1}, {1, 0, -1}, {-1, 0, -1},
+				{0, 1, 1}, {0, -1, 1}, {0, 1, -1}, {0, -1, -1},
+			};
+
+			seed ^= static_cast<uint32_t>(x) * 0x9E3779B1u;
+			seed ^= static_cast<uint32_t>(y) * 0xC2B2AE3Du;
+			seed ^= static_cast<uint32_t>(z) * 0x85EBCA77u;
+			seed ^= (seed >> 16);
+			seed *= 0x27D4EB2Du;
+			seed ^= (seed >> 15);
+
+			return directions[seed % 12];
+		}
+	}
+
+	float sample2D(uint32_t seed, float x, float z) {
+		int x0 = static_cast<int>(floor(x));
+		int z0 = static_cast<int>(floor(z));
+		float fx = x - x0;
+		float fz = z - z0;
+
+		float bl = glm::dot(vec2(fx, fz), gradient(seed, x0, z0));
+		float br = glm::dot(vec2(fx - 1, fz), gradient(seed, x0 + 1, z0));
+		float ul = glm::dot(vec2(fx, fz - 1), gradient(seed, x0, z0 + 1));
+		float ur = glm::dot(vec2(fx - 1, fz - 1), gradient(seed, x0 + 1, z0 + 1));
+
+		float tx = glm::smoothstep(0.0f, 1.0f, fx);
+		float tz = glm::smoothstep(0.0f, 1.0f, fz);
+
+		return glm::mix(glm::mix(bl, br, tx), glm::mix(ul, ur, tx), tz);
+	}
+
+	float sample3D(uint32_t seed, float x, float y, float z) {
+		int x0 = static_cast<int>(floor(x));
+		int y0 = static_cast<int>(floor(y));
+		int z0 = static_cast<int>(floor(z));
+		vec3 f(x - x0, y - y0, z - z0);
+
+		float corners[8];
+		for (int i = 0; i < 8; i++) {
+			vec3 corner(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+			corners[i] = glm::dot(f - corner, gradient3(seed, x0 + (i & 1), y0 + ((i >> 1) & 1), z0 + ((i >> 2) & 1)));
+		}
+
+		float tx = glm::smoothstep(0.0f, 1.0f, f.x);
+		float ty = glm::smoothstep(0.0f, 1.0f, f.y);
+		float tz = glm::smoothstep(0.0f, 1.0f, f.z);
+
+		float x00 = glm::mix(corners[0], corners[1], tx);
+		float x10 = glm::mix(corners[2], corners[3], tx);
+		float x01 = glm::mix(corners[4], corners[5], tx);
+		float x11 = glm::mix(corners[6], corners[7], tx);
+
+		return glm::mix(glm::mix(x00, x10, ty), glm::mix(x01, x11, ty), tz);
+	}
+
+	TileCache::TileCache(uint32_t seed, int chunkWidth, int chunkDepth, int octaves, float frequency, int amplitude, vector<int> strides,
+		int maxTiles)
+		: seed(seed), chunkWidth(chunkWidth), chunkDepth(chunkDepth), octaves(octaves), frequency(frequency), amplitude(amplitude),
+		strides(std::move(strides)), maxTiles(std::max(maxTiles, 1)) {
+		this->strides.resize(octaves, 1);
+	}
+
+	void TileCache::slice(int chunkx, int chunkz, vector<int>& offsets) {
+		ivec2 tileCoords(floorDiv(chunkx, TILE_CHUNKS), floorDiv(chunkz, TILE_CHUNKS));
+		const Tile& tile = getTile(tileCoords);
+
+		const int tileWidth = TILE_CHUNKS * chunkWidth;
+		const int startX = (chunkx - tileCoords.x * TILE_CHUNKS) * chunkWidth;
+		const int startZ = (chunkz - tileCoords.y * TILE_CHUNKS) * chunkDepth;
+
+		offsets.resize(chunkWidth * chunkDepth);
+		for (int z = 0; z < chunkDepth; z++) {
+			const int* row = &tile.offsets[startX + tileWidth * (startZ + z)];
+			std::copy(row, row + chunkWidth, &offsets[chunkWidth * z]);
+		}
+	}
+
+	const TileCache::Tile& TileCache::getTile(ivec2 tileCoords) {
+		auto it = tiles.find(tileCoords);
+		if (it != tiles.end()) {
+			stats.hits++;
+			lru.splice(lru.begin(), lru, it->second.lruPosition);
+			return it->second;
+		}
+
+		PROFILE_SCOPE("Noise::TileCache::build");
+		stats.misses++;
+		const auto start = std::chrono::steady_clock::now();
+
+		if (tiles.size() >= maxTiles) {
+			tiles.erase(lru.back());
+			lru.pop_back();
+			stats.evictions++;
+		}
+
+		const int tileWidth = TILE_CHUNKS * chunkWidth;
+		const int tileDepth = TILE_CHUNKS * chunkDepth;
+
+		lru.push_front(tileCoords);
+		Tile& tile = tiles[tileCoords];
+		tile.lruPosition = lru.begin();
+		tile.offsets.assign(tileWidth * tileDepth, 0);
+
+		float octaveFrequency = frequency;
+		int octaveAmplitude = amplitude;
+		for (int i = 0; i < octaves; i++) {
+			perlin(seed, octaveFrequency, octaveAmplitude,
+				tileCoords.x * tileWidth, tileCoords.y * tileDepth, tileWidth, tileDepth, tile.offsets, strides[i]);
+			octaveFrequency /= 2;
+			octaveAmplitude /= 2;
+		}
+
+		stats.generateMicros += std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		return tile;
+	}
+
+	void TileCache::reportMemory(MemoryReport& report) const {
+		report.add("noise", "tiles", tiles.size());
+		for (const auto& entry : tiles) report.add("noise", "tileBytes", entry.second.offsets.capacity() * sizeof(int));
+	}
+
+	void TileCache::printStats(std::ostream& os) const {
+		uint64_t lookups = stats.hits + stats.misses;
+		os << "Noise tiles: " << tiles.size() << "/" << maxTiles << " resident, "
+			<< "hit rate " << (lookups ? 100.0 * stats.hits / lookups : 0.0) << "% (" << stats.hits << "/" << lookups << "), "
+			<< stats.evictions << " evictions, "
+			<< (lookups ? stats.generateMicros / static_cast<double>(lookups) : 0.0) << "us of noise per chunk\n";
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "memory.h"
+#include "vecn_hash.hpp"
+
+using std::vector;
+
+using glm::vec2;
+using glm::vec3;
+using glm::ivec2;
+
+namespace Noise {
+	// random unit gradient for a lattice point
+	vec2 gradient(uint32_t seed, int x, int z);
+
+	// adds one octave of 2D perlin noise to a width x depth grid of columns,
+	// starting at world column (originX, originZ), offsets is indexed x + width * z
+	// gradients are computed once per lattice point instead of once per column corner
+	// with a stride above 1 only every stride-th column is sampled and the rest bilinearly interpolated,
+	// close enough for octaves much smoother than the stride
+	void perlin(uint32_t seed, float frequency, float amplitude,
+		int originX, int originZ, int width, int depth, vector<int>& offsets, int stride = 1);
+
+	// single point perlin samples in roughly [-1, 1], coordinates are already scaled by frequency
+	float sample2D(uint32_t seed, float x, float z);
+	float sample3D(uint32_t seed, float x, float y, float z);
+
+	// floor division, so negative coordinates land in the right tile
+	inline int floorDiv(int a, int b) {
+		return (a >= 0 ? a : a - b + 1) / b;
+	}
+
+	/*
+	World level cache of heightmap offsets
+	Each tile covers TILE_CHUNKS x TILE_CHUNKS chunks, so neighbouring chunks share the
+	low frequency lattice instead of each recomputing it. Tiles are kept in a bounded LRU
+	*/
+	class TileCache
+	{
+	public:
+		static constexpr int TILE_CHUNKS = 4;
+
+		// enough for the benchmarks' squares, the world and server size theirs with tilesFor
+		static constexpr int DEFAULT_MAX_TILES = 32;
+
+		// tiles a square of view chunks can overlap, plus a ring so stepping sideways doesn't evict what comes back
+		static constexpr int tilesFor(int viewChunks) {
+			const int across = (viewChunks + TILE_CHUNKS - 1) / TILE_CHUNKS + 2;
+			return across * across;
+		}
+
+		struct Stats {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			int64_t generateMicros = 0; // total time spent building tiles
+		};
+
+		// strides[i] is the sampling stride of octave i, see perlin, missing ones are 1
+		TileCache(uint32_t seed, int chunkWidth, int chunkDepth, int octaves, float frequency, int amplitude, vector<int> strides = {},
+			int maxTiles = DEFAULT_MAX_TILES);
+
+		// copies the offsets of one chunk out of its tile, building the tile if needed
+		void slice(int chunkx, int chunkz, vector<int>& offsets);
+
+		inline const Stats& getStats() const {
+			return stats;
+		}
+
+		void printStats(std::ostream& os) const;
+
+		void reportMemory(MemoryReport& report) const;
+
+	private:
+		struct Tile {
+			vector<int> offsets;
+			std::list<ivec2>::iterator lruPosition;
+		};
+
+		uint32_t seed;
+		int chunkWidth, chunkDepth;
+		int octaves;
+		float frequency;
+		int amplitude;
+		vector<int> strides;
+		size_t maxTiles;
+
+		std::unordered_map<ivec2, Tile, vec2Hash> tiles;
+		std::list<ivec2> lru; // most recently used at the front
+
+		Stats stats;
+
+		const Tile& getTile(ivec2 tileCoords);
+	};
+}
@@ -1,5 +1,16 @@
 #include "player.h"
 
+void Player::moveTo(const World& world, vec3 target) {
+	if (!collides) {
+		camera.Position = target;
+		return;
+	}
+
+	Collision::AABB box = getBox();
+	glm::bvec3 blocked;
+	camera.Position += world.moveBox(box, target - camera.Position, blocked);
+}
+
 bool Player::selectBlock(World & world) {
 	vec3 start = camera.Position + vec3(0.5);
 	vec3 dir = glm::normalize(camera.Front);
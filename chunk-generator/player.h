@@ -9,6 +9,11 @@ using glm::ivec3;
 
 constexpr int MAX_SELECT_DISTANCE = 8;
 
+// the player's collision box around the camera, in blocks
+constexpr float PLAYER_HALF_WIDTH = 0.3f;
+constexpr float PLAYER_EYE_HEIGHT = 1.6f; // feet to camera
+constexpr float PLAYER_HEAD_ROOM = 0.2f; // camera to top of the box
+
 class Player
 {
 public:
@@ -20,12 +25,31 @@ public:
 
 	Camera camera;
 
-	Player(ivec3 start = ivec3(0, 32, 0)) : camera{ start } {}
+	// off flies through blocks
+	bool collides = true;
+
+	Player(ivec3 start = ivec3(0, HEIGHT_BASELINE + 8, 0)) : camera{ start } {}
 
-	inline ivec2 getChunkCoords() const {
-		return { camera.Position.x / CHUNK_MAX_X, camera.Position.z / CHUNK_MAX_Z };
+	inline ivec3 getChunkCoords() const {
+		// floored so chunks left of and behind the origin don't share chunk 0
+		return {
+			glm::floor(camera.Position.x / CHUNK_MAX_X),
+			glm::floor(camera.Position.y / CHUNK_MAX_Y),
+			glm::floor(camera.Position.z / CHUNK_MAX_Z)
+		};
 	}
 
+	inline Collision::AABB getBox() const {
+		const vec3& eye = camera.Position;
+		return {
+			vec3(eye.x - PLAYER_HALF_WIDTH, eye.y - PLAYER_EYE_HEIGHT, eye.z - PLAYER_HALF_WIDTH),
+			vec3(eye.x + PLAYER_HALF_WIDTH, eye.y + PLAYER_HEAD_ROOM, eye.z + PLAYER_HALF_WIDTH)
+		};
+	}
+
+	// moves the camera towards target, sliding along any blocks in the way
+	void moveTo(const World& world, vec3 target);
+
 	// Casts a ray from center of screen (camera) and returns true if it hits a block within MAX_SELECT_DISTANCE
 	// modifies the selected Raycast field with this information
 	bool selectBlock(World & world);
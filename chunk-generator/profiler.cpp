@@ -0,0 +1,153 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+namespace {
+	// small sequential ids read better in trace viewers than hashed thread ids
+	uint32_t currentThreadId() {
+		static std::atomic<uint32_t> nextId{ 0 };
+		thread_local uint32_t id = nextId++;
+		return id;
+	}
+
+	// GPU events get their own track below the CPU threads
+	constexpr uint32_t GPU_TRACK = 1000;
+}
+
+Profiler::Profiler() : epoch(Clock::now()) {
+	events.resize(PROFILER_MAX_EVENTS);
+}
+
+void Profiler::setEnabled(bool value) {
+	enabled.store(value, std::memory_order_relaxed);
+	std::cerr << "Profiler " << (value ? "enabled" : "disabled") << std::endl;
+}
+
+void Profiler::beginFrame() {
+	frameStart = now();
+
+	// queries from before the profiler was turned off would come back as this frame's when it is turned on again
+	if (!isEnabled()) {
+		gpuQueryCount.fill(0);
+		return;
+	}
+
+	if (!gpuQueriesCreated) {
+		for (auto& frame : gpuQueries) {
+			for (auto& query : frame) glGenQueries(1, &query.id);
+		}
+		gpuQueriesCreated = true;
+	}
+
+	// this slot was last used PROFILER_GPU_LATENCY frames ago, so its results should be ready
+	int frameSlot = frameIndex % PROFILER_GPU_LATENCY;
+	collectGpuQueries(frameSlot);
+}
+
+void Profiler::endFrame() {
+	int64_t duration = now() - frameStart;
+	frameTimes[frameIndex % PROFILER_FRAME_HISTORY] = duration / 1000.0f;
+	frameTimeCount = std::min(frameTimeCount + 1, PROFILER_FRAME_HISTORY);
+
+	if (isEnabled()) record("frame", frameStart, duration);
+
+	frameIndex++;
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t duration, bool gpu) {
+	uint64_t index = eventCount.fetch_add(1, std::memory_order_relaxed) & (PROFILER_MAX_EVENTS - 1);
+	events[index] = { name, start, duration, gpu ? GPU_TRACK : currentThreadId(), gpu };
+}
+
+int Profiler::beginGpuQuery(const char* name) {
+	int frameSlot = frameIndex % PROFILER_GPU_LATENCY;
+	if (!gpuQueriesCreated || gpuQueryActive || gpuQueryCount[frameSlot] >= PROFILER_GPU_QUERIES) return -1;
+
+	int slot = gpuQueryCount[frameSlot]++;
+	GpuQuery& query = gpuQueries[frameSlot][slot];
+	query.name = name;
+	query.cpuStart = now();
+
+	glBeginQuery(GL_TIME_ELAPSED, query.id);
+	gpuQueryActive = true;
+	return slot;
+}
+
+void Profiler::endGpuQuery() {
+	glEndQuery(GL_TIME_ELAPSED);
+	gpuQueryActive = false;
+}
+
+void Profiler::collectGpuQueries(int frameSlot) {
+	for (int i = 0; i < gpuQueryCount[frameSlot]; i++) {
+		GpuQuery& query = gpuQueries[frameSlot][i];
+
+		GLint available = 0;
+		glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) continue; // never block on the GPU, drop the sample instead
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed);
+
+		// GPU events are placed at the time they were submitted on the CPU
+		record(query.name, query.cpuStart, static_cast<int64_t>(elapsed / 1000), true);
+	}
+	gpuQueryCount[frameSlot] = 0;
+}
+
+float Profiler::framePercentile(float p) const {
+	if (frameTimeCount == 0) return 0.0f;
+
+	std::vector<float> sorted(frameTimes.begin(), frameTimes.begin() + frameTimeCount);
+	size_t rank = std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5f));
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+void Profiler::printSummary(std::ostream& os) const {
+	os << "Frame time over " << frameTimeCount << " frames: "
+		<< "p50 " << framePercentile(0.5f) << "ms, "
+		<< "p99 " << framePercentile(0.99f) << "ms, "
+		<< "max " << framePercentile(1.0f) << "ms\n";
+
+	// average time per marker over whatever is still in the ring buffer
+	struct Total { int64_t duration = 0; int count = 0; };
+	std::map<std::string, Total> totals;
+
+	uint64_t count = std::min<uint64_t>(eventCount.load(), PROFILER_MAX_EVENTS);
+	for (uint64_t i = 0; i < count; i++) {
+		const Event& event = events[i];
+		std::string name = event.gpu ? std::string("gpu:") + event.name : event.name;
+		totals[name].duration += event.duration;
+		totals[name].count++;
+	}
+
+	for (const auto& [name, total] : totals) {
+		os << "  " << name << ": " << total.duration / 1000.0f / total.count << "ms avg over " << total.count << "\n";
+	}
+}
+
+bool Profiler::dumpChromeTrace(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERR :: COULD NOT WRITE TRACE TO " << path << std::endl;
+		return false;
+	}
+
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GPU_TRACK << ",\"args\":{\"name\":\"GPU\"}}";
+
+	uint64_t count = std::min<uint64_t>(eventCount.load(), PROFILER_MAX_EVENTS);
+	for (uint64_t i = 0; i < count; i++) {
+		const Event& event = events[i];
+		file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+			<< "\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+			<< ",\"pid\":0,\"tid\":" << event.thread << "}";
+	}
+	file << "\n]}\n";
+
+	std::cerr << "Wrote " << count << " profiler events to " << path << std::endl;
+	return true;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+Lightweight frame profiler
+CPU markers are scoped timers that write into a fixed ring buffer, GPU markers wrap
+GL_TIME_ELAPSED queries that are read back a few frames later so they never stall.
+A marker costs one relaxed load while the profiler is disabled at runtime,
+and compiles out entirely when ENABLE_PROFILER is 0
+*/
+
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+static constexpr int PROFILER_MAX_EVENTS = 1 << 16; // must be a power of 2
+static constexpr int PROFILER_FRAME_HISTORY = 600; // frames kept for the percentile summary
+static constexpr int PROFILER_GPU_QUERIES = 32; // per frame
+static constexpr int PROFILER_GPU_LATENCY = 4; // frames to wait before reading a query back
+
+// count, average and worst of a repeated wait
+struct LatencyStats {
+	uint64_t count = 0;
+	int64_t totalMicros = 0;
+	int64_t maxMicros = 0;
+
+	inline void add(int64_t micros) {
+		count++;
+		totalMicros += micros;
+		maxMicros = std::max(maxMicros, micros);
+	}
+
+	inline double averageMillis() const {
+		return count ? totalMicros / 1000.0 / count : 0.0;
+	}
+
+	inline double maxMillis() const {
+		return maxMicros / 1000.0;
+	}
+};
+
+class Profiler // Singleton
+{
+public:
+	struct Event {
+		const char* name;
+		int64_t start; // microseconds since the profiler was created
+		int64_t duration;
+		uint32_t thread;
+		bool gpu;
+	};
+
+	static Profiler& getInstance() {
+		static Profiler instance;
+		return instance;
+	}
+
+	static inline bool isEnabled() {
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	void setEnabled(bool value);
+
+	// microseconds since the profiler was created
+	inline int64_t now() const {
+		return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - epoch).count();
+	}
+
+	// frame boundaries drive the frame time history and the GPU query read back
+	void beginFrame();
+	void endFrame();
+
+	void record(const char* name, int64_t start, int64_t duration, bool gpu = false);
+
+	// returns the query slot, or -1 if no query was started
+	// GL_TIME_ELAPSED queries cannot nest, so an inner GPU scope is dropped
+	int beginGpuQuery(const char* name);
+	void endGpuQuery();
+
+	// p in [0, 1], in milliseconds over the last PROFILER_FRAME_HISTORY frames
+	float framePercentile(float p) const;
+
+	void printSummary(std::ostream& os) const;
+
+	// writes every buffered event as Chrome trace / Perfetto JSON
+	bool dumpChromeTrace(const std::string& path) const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct GpuQuery {
+		unsigned int id = 0;
+		const char* name = nullptr;
+		int64_t cpuStart = 0;
+	};
+
+	static inline std::atomic<bool> enabled{ false };
+
+	Clock::time_point epoch;
+
+	std::vector<Event> events;
+	std::atomic<uint64_t> eventCount{ 0 };
+
+	std::array<float, PROFILER_FRAME_HISTORY> frameTimes{};
+	int frameTimeCount = 0;
+	int64_t frameStart = 0;
+	uint64_t frameIndex = 0;
+
+	// one set of queries per frame in flight
+	std::array<std::array<GpuQuery, PROFILER_GPU_QUERIES>, PROFILER_GPU_LATENCY> gpuQueries{};
+	std::array<int, PROFILER_GPU_LATENCY> gpuQueryCount{};
+	bool gpuQueryActive = false;
+	bool gpuQueriesCreated = false;
+
+	Profiler();
+
+	void collectGpuQueries(int frameSlot);
+};
+
+// Records the lifetime of the enclosing scope as a CPU event
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(const char* name) : name(name) {
+		if (Profiler::isEnabled()) start = Profiler::getInstance().now();
+	}
+
+	~ScopedTimer() {
+		if (start >= 0) {
+			Profiler& profiler = Profiler::getInstance();
+			profiler.record(name, start, profiler.now() - start);
+		}
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	const char* name;
+	int64_t start = -1;
+};
+
+// Measures the GPU time of the commands submitted inside the enclosing scope
+class ScopedGpuTimer
+{
+public:
+	explicit ScopedGpuTimer(const char* name) {
+		if (Profiler::isEnabled()) slot = Profiler::getInstance().beginGpuQuery(name);
+	}
+
+	~ScopedGpuTimer() {
+		if (slot >= 0) Profiler::getInstance().endGpuQuery();
+	}
+
+	ScopedGpuTimer(const ScopedGpuTimer&) = delete;
+	ScopedGpuTimer& operator=(const ScopedGpuTimer&) = delete;
+
+private:
+	int slot = -1;
+};
+
+#if ENABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ScopedGpuTimer PROFILE_CONCAT(profileGpuScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#endif
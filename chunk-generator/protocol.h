@@ -0,0 +1,155 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "block.h"
+#include "chunk.h"
+#include "net.h"
+
+using glm::ivec2;
+using glm::ivec3;
+using std::vector;
+
+/*
+Payloads of the messages between the chunk server and its clients, see Net::MessageType
+Each encodes to the bytes of one message and decodes back, nothing if the bytes are short
+Blocks travel run length encoded as BlockStorage::compress writes them, light is left
+for the client to work out since it follows from the blocks and is far bigger
+*/
+namespace Protocol {
+	struct Subscribe {
+		ivec3 center; // chunk coords
+		int32_t radius; // chunks along x and z, the box is 2 * radius + 1 wide
+		int32_t verticalRadius; // and 2 * verticalRadius + 1 tall, less where it leaves the world
+
+		inline vector<uint8_t> encode() const {
+			vector<uint8_t> out;
+			Net::Writer writer(out);
+			writer.put<int32_t>(center.x);
+			writer.put<int32_t>(center.y);
+			writer.put<int32_t>(center.z);
+			writer.put<int32_t>(radius);
+			writer.put<int32_t>(verticalRadius);
+			return out;
+		}
+
+		static inline std::optional<Subscribe> decode(const vector<uint8_t>& payload) {
+			Net::Reader reader(payload);
+			Subscribe subscribe;
+			subscribe.center.x = reader.get<int32_t>();
+			subscribe.center.y = reader.get<int32_t>();
+			subscribe.center.z = reader.get<int32_t>();
+			subscribe.radius = reader.get<int32_t>();
+			subscribe.verticalRadius = reader.get<int32_t>();
+			if (!reader.ok) return std::nullopt;
+			return subscribe;
+		}
+	};
+
+	struct Edit {
+		ivec3 worldPosition;
+		Block::BlockType type; // air removes
+
+		inline vector<uint8_t> encode() const {
+			vector<uint8_t> out;
+			Net::Writer writer(out);
+			writer.put<int32_t>(worldPosition.x);
+			writer.put<int32_t>(worldPosition.y);
+			writer.put<int32_t>(worldPosition.z);
+			writer.put<uint8_t>(type);
+			return out;
+		}
+
+		static inline std::optional<Edit> decode(const vector<uint8_t>& payload) {
+			Net::Reader reader(payload);
+			Edit edit;
+			edit.worldPosition.x = reader.get<int32_t>();
+			edit.worldPosition.y = reader.get<int32_t>();
+			edit.worldPosition.z = reader.get<int32_t>();
+			edit.type = reader.get<uint8_t>();
+			if (!reader.ok) return std::nullopt;
+			return edit;
+		}
+	};
+
+	struct ChunkData {
+		ivec3 coords;
+		vector<uint8_t> blocks; // run length encoded, see BlockStorage::compress
+
+		inline vector<uint8_t> encode() const {
+			vector<uint8_t> out;
+			out.reserve(16 + blocks.size());
+			Net::Writer writer(out);
+			writer.put<int32_t>(coords.x);
+			writer.put<int32_t>(coords.y);
+			writer.put<int32_t>(coords.z);
+			writer.putBytes(blocks);
+			return out;
+		}
+
+		static inline std::optional<ChunkData> decode(const vector<uint8_t>& payload) {
+			Net::Reader reader(payload);
+			ChunkData chunk;
+			chunk.coords.x = reader.get<int32_t>();
+			chunk.coords.y = reader.get<int32_t>();
+			chunk.coords.z = reader.get<int32_t>();
+			chunk.blocks = reader.getBytes();
+			if (!reader.ok) return std::nullopt;
+			return chunk;
+		}
+	};
+
+	// blocks changed in one chunk, four bytes each, decoding fails on a change outside the chunk
+	struct Delta {
+		struct Change {
+			ivec3 coords; // in chunk coords, each fits a byte
+			Block::BlockType type;
+		};
+
+		ivec3 coords;
+		vector<Change> changes;
+
+		inline vector<uint8_t> encode() const {
+			vector<uint8_t> out;
+			out.reserve(14 + 4 * changes.size());
+			Net::Writer writer(out);
+			writer.put<int32_t>(coords.x);
+			writer.put<int32_t>(coords.y);
+			writer.put<int32_t>(coords.z);
+			writer.put<uint16_t>(static_cast<uint16_t>(changes.size()));
+			for (const Change& change : changes) {
+				writer.put<uint8_t>(static_cast<uint8_t>(change.coords.x));
+				writer.put<uint8_t>(static_cast<uint8_t>(change.coords.y));
+				writer.put<uint8_t>(static_cast<uint8_t>(change.coords.z));
+				writer.put<uint8_t>(change.type);
+			}
+			return out;
+		}
+
+		static inline std::optional<Delta> decode(const vector<uint8_t>& payload) {
+			Net::Reader reader(payload);
+			Delta delta;
+			delta.coords.x = reader.get<int32_t>();
+			delta.coords.y = reader.get<int32_t>();
+			delta.coords.z = reader.get<int32_t>();
+			uint16_t count = reader.get<uint16_t>();
+			for (uint16_t i = 0; i < count && reader.ok; i++) {
+				Change change;
+				change.coords.x = reader.get<uint8_t>();
+				change.coords.y = reader.get<uint8_t>();
+				change.coords.z = reader.get<uint8_t>();
+				change.type = reader.get<uint8_t>();
+
+				// a byte reaches past the chunk, a change outside it would be written into other blocks or another chunk
+				if (change.coords.x >= CHUNK_MAX_X || change.coords.y >= CHUNK_MAX_Y || change.coords.z >= CHUNK_MAX_Z) return std::nullopt;
+				delta.changes.push_back(change);
+			}
+			if (!reader.ok) return std::nullopt;
+			return delta;
+		}
+	};
+}
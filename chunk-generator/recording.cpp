@@ -0,0 +1,99 @@
+#include "recording.h"
+
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+static constexpr int RECORDING_VERSION = 1;
+
+bool Recording::save(const std::string& path) const {
+	std::ofstream file(path);
+	if (!file) {
+		std::cout << "ERR :: COULD NOT WRITE RECORDING TO " << path << std::endl;
+		return false;
+	}
+
+	// enough digits that positions read back exactly
+	file << std::setprecision(std::numeric_limits<float>::max_digits10);
+	file << "recording " << RECORDING_VERSION << "\n";
+	file << "world " << seed << " " << densityTerrain << "\n";
+
+	size_t edit = 0;
+	for (size_t tick = 0; tick <= ticks.size(); tick++) {
+		for (; edit < edits.size() && edits[edit].tick == tick; edit++) {
+			const Edit& e = edits[edit];
+			file << "e " << e.coords.x << " " << e.coords.y << " " << e.coords.z << " " << static_cast<int>(e.type) << "\n";
+		}
+		if (tick == ticks.size()) break;
+
+		const Tick& t = ticks[tick];
+		file << "t " << t.position.x << " " << t.position.y << " " << t.position.z << " " << t.yaw << " " << t.pitch << "\n";
+	}
+
+	std::cerr << "Wrote " << ticks.size() << " ticks and " << edits.size() << " edits to " << path << std::endl;
+	return true;
+}
+
+std::optional<Recording> Recording::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file) {
+		std::cout << "ERR :: COULD NOT READ RECORDING " << path << std::endl;
+		return std::nullopt;
+	}
+
+	std::string word;
+	int version = 0;
+	Recording recording;
+	if (!(file >> word >> version) || word != "recording" || version != RECORDING_VERSION
+		|| !(file >> word >> recording.seed >> recording.densityTerrain) || word != "world") {
+		std::cout << "ERR :: " << path << " IS NOT A VERSION " << RECORDING_VERSION << " RECORDING" << std::endl;
+		return std::nullopt;
+	}
+
+	std::string line;
+	int lineNumber = 2;
+	std::getline(file, line); // rest of the world line
+	while (std::getline(file, line)) {
+		lineNumber++;
+		if (line.empty()) continue;
+
+		std::istringstream in(line);
+		std::string kind;
+		in >> kind;
+
+		bool ok = false;
+		if (kind == "t") {
+			Tick tick;
+			ok = static_cast<bool>(in >> tick.position.x >> tick.position.y >> tick.position.z >> tick.yaw >> tick.pitch);
+			if (ok) recording.ticks.push_back(tick);
+		}
+		else if (kind == "e") {
+			ivec3 coords;
+			int type;
+			ok = static_cast<bool>(in >> coords.x >> coords.y >> coords.z >> type);
+			if (ok) recording.edits.push_back({ static_cast<uint32_t>(recording.ticks.size()), coords, static_cast<Block::BlockType>(type) });
+		}
+
+		if (!ok) {
+			std::cout << "ERR :: BAD LINE " << lineNumber << " IN RECORDING " << path << std::endl;
+			return std::nullopt;
+		}
+	}
+
+	return recording;
+}
+
+float ReplayStats::percentile(float p) const {
+	if (frameMillis.empty()) return 0.0f;
+	vector<float> sorted = frameMillis;
+	size_t index = std::min(sorted.size() - 1, static_cast<size_t>(p * (sorted.size() - 1) + 0.5f));
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index];
+}
+
+void ReplayStats::print(std::ostream& os) const {
+	os << "Replay: " << frameMillis.size() << " frames, frame time p50 " << percentile(0.5f) << "ms, p95 "
+		<< percentile(0.95f) << "ms, p99 " << percentile(0.99f) << "ms, max " << percentile(1.0f) << "ms, "
+		<< hitches() << " hitches over " << HITCH_MILLIS << "ms\n";
+}
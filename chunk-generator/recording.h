@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "block.h"
+#include "camera.h"
+
+using glm::ivec3;
+using glm::vec3;
+using std::vector;
+
+// replays step the world this far each frame no matter how long the frame took
+static constexpr float REPLAY_TIMESTEP = 1.0f / 60.0f;
+
+// frames longer than this count as hitches in a replay report
+static constexpr float HITCH_MILLIS = 2000.0f * REPLAY_TIMESTEP;
+
+/*
+Camera path and block edits of a play session, sampled once per frame
+Saved as text, one line per tick or edit, so a recording can be read and trimmed by hand
+Replaying one tick per frame with a fixed timestep makes every run of a recording ask the
+world for the same chunks and edits in the same order
+*/
+class Recording
+{
+public:
+	struct Tick {
+		vec3 position;
+		float yaw, pitch;
+	};
+
+	// applied before the tick with the same index, placing air removes the block
+	struct Edit {
+		uint32_t tick;
+		ivec3 coords;
+		Block::BlockType type;
+	};
+
+	uint32_t seed = 0;
+	bool densityTerrain = false;
+
+	vector<Tick> ticks;
+	vector<Edit> edits; // in tick order
+
+	inline void addTick(const Camera& camera) {
+		ticks.push_back({ camera.Position, camera.Yaw, camera.Pitch });
+	}
+
+	// lands on the tick after the current one, edits come in between frames
+	inline void addEdit(ivec3 coords, Block::BlockType type) {
+		edits.push_back({ static_cast<uint32_t>(ticks.size()), coords, type });
+	}
+
+	bool save(const std::string& path) const;
+
+	// nothing if the file is missing or malformed
+	static std::optional<Recording> load(const std::string& path);
+};
+
+// frame times of a replay and a summary of them
+class ReplayStats
+{
+public:
+	inline void addFrame(float millis) {
+		frameMillis.push_back(millis);
+	}
+
+	// p in [0, 1]
+	float percentile(float p) const;
+
+	inline size_t hitches() const {
+		return std::count_if(frameMillis.begin(), frameMillis.end(), [](float millis) { return millis > HITCH_MILLIS; });
+	}
+
+	void print(std::ostream& os) const;
+
+private:
+	vector<float> frameMillis;
+};
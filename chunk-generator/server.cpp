@@ -0,0 +1,226 @@
+#include "server.h"
+
+#include <algorithm>
+
+#include "profiler.h"
+#include "world.h"
+
+ChunkServer::ChunkServer(uint32_t seed, bool useDensityTerrain, bool persistEdits) : seed(seed),
+	noiseTiles(seed, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES,
+		Noise::TileCache::tilesFor(2 * MAX_SUBSCRIBE_RADIUS + 1)) {
+	if (useDensityTerrain) densityTerrain = World::buildDensityTerrain(seed);
+	if (persistEdits) journal.emplace(EditJournal::directoryFor(seed, useDensityTerrain));
+}
+
+bool ChunkServer::listen(uint16_t port) {
+	std::optional<Net::Listener> opened = Net::Listener::listen(port);
+	if (!opened) return false;
+	listener.emplace(std::move(*opened));
+	std::cerr << "Serving chunks on port " << port << std::endl;
+	return true;
+}
+
+void ChunkServer::run(const std::atomic<bool>& stop) {
+	while (!stop.load(std::memory_order_relaxed)) step(50);
+}
+
+void ChunkServer::step(int timeoutMillis) {
+	PROFILE_SCOPE("ChunkServer::step");
+
+	// clients with a full buffer only wake the server once they can take more
+	vector<std::pair<SocketHandle, bool>> sockets;
+	if (listener) sockets.push_back({ listener->handle(), false });
+	for (const auto& client : clients) sockets.push_back({ client->connection.handle(), client->connection.pendingBytes() > 0 });
+	Net::wait(sockets, timeoutMillis);
+
+	if (listener) {
+		while (auto connection = listener->accept()) {
+			clients.push_back(std::make_unique<Client>(std::move(*connection)));
+			stats.connections++;
+		}
+	}
+
+	for (auto& client : clients) {
+		client->connection.receive();
+		while (auto message = client->connection.next()) handle(*client, *message);
+	}
+
+	sendDeltas();
+
+	for (auto& client : clients) {
+		sendChunks(*client);
+		client->connection.flush();
+	}
+
+	size_t connected = clients.size();
+	clients.erase(std::remove_if(clients.begin(), clients.end(), [](const auto& client) {
+		return !client->connection.isOpen();
+	}), clients.end());
+	if (clients.size() != connected) evictChunks();
+}
+
+void ChunkServer::handle(Client& client, const Net::Message& message) {
+	switch (message.type) {
+		case Net::MessageType::SUBSCRIBE:
+			if (auto subscription = Protocol::Subscribe::decode(message.payload)) subscribe(client, *subscription);
+			break;
+		case Net::MessageType::EDIT:
+			if (auto e = Protocol::Edit::decode(message.payload)) edit(client, *e);
+			break;
+		default:
+			std::cout << "ERR :: UNEXPECTED MESSAGE " << static_cast<int>(message.type) << " FROM CLIENT" << std::endl;
+			break;
+	}
+}
+
+Chunk& ChunkServer::getChunk(ivec3 coords) {
+	auto found = chunks.find(coords);
+	if (found != chunks.end()) return *found->second;
+
+	stats.chunksGenerated++;
+	std::unique_ptr<Chunk> chunk = densityTerrain
+		? std::make_unique<Chunk>(seed, coords.x, coords.y, coords.z, *densityTerrain)
+		: std::make_unique<Chunk>(seed, coords.x, coords.y, coords.z, noiseTiles);
+	if (journal) journal->apply(coords, *chunk);
+	return *chunks.emplace(coords, std::move(chunk)).first->second;
+}
+
+void ChunkServer::subscribe(Client& client, Protocol::Subscribe subscription) {
+	subscription.radius = std::clamp(subscription.radius, 0, MAX_SUBSCRIBE_RADIUS);
+	subscription.verticalRadius = std::clamp(subscription.verticalRadius, 0, WORLD_CHUNKS_Y);
+	client.subscription = subscription;
+
+	// nothing is generated above or below the world
+	const ivec3 center = subscription.center;
+	const int bottom = std::max(center.y - subscription.verticalRadius, 0);
+	const int top = std::min(center.y + subscription.verticalRadius, WORLD_CHUNKS_Y - 1);
+	const auto inBox = [&](ivec3 coords) {
+		return std::abs(coords.x - center.x) <= subscription.radius && std::abs(coords.z - center.z) <= subscription.radius
+			&& coords.y >= bottom && coords.y <= top;
+	};
+	for (auto it = client.sent.begin(); it != client.sent.end();) {
+		if (inBox(*it)) ++it;
+		else it = client.sent.erase(it);
+	}
+
+	client.toSend.clear();
+	for (int x = center.x - subscription.radius; x <= center.x + subscription.radius; x++) {
+		for (int y = bottom; y <= top; y++) {
+			for (int z = center.z - subscription.radius; z <= center.z + subscription.radius; z++) {
+				if (client.sent.find(ivec3(x, y, z)) == client.sent.end()) client.toSend.push_back(ivec3(x, y, z));
+			}
+		}
+	}
+
+	auto distance = [center](ivec3 coords) {
+		ivec3 offset = coords - center;
+		return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z;
+	};
+	std::sort(client.toSend.begin(), client.toSend.end(), [&distance](ivec3 a, ivec3 b) {
+		return distance(a) > distance(b);
+	});
+
+	evictChunks();
+}
+
+void ChunkServer::evictChunks() {
+	PROFILE_SCOPE("ChunkServer::evictChunks");
+	for (auto it = chunks.begin(); it != chunks.end();) {
+		const ivec3 coords = it->first;
+		bool wanted = unjournaled.find(coords) != unjournaled.end();
+		for (size_t i = 0; i < clients.size() && !wanted; i++) {
+			const std::optional<Protocol::Subscribe>& subscription = clients[i]->subscription;
+			wanted = subscription && std::abs(coords.x - subscription->center.x) <= subscription->radius
+				&& std::abs(coords.z - subscription->center.z) <= subscription->radius
+				&& std::abs(coords.y - subscription->center.y) <= subscription->verticalRadius;
+		}
+
+		if (wanted) ++it;
+		else {
+			it = chunks.erase(it);
+			stats.chunksEvicted++;
+		}
+	}
+}
+
+void ChunkServer::edit(Client& client, const Protocol::Edit& edit) {
+	const ivec3 position = edit.worldPosition;
+	if (position.y < 0 || position.y >= WORLD_HEIGHT) return;
+
+	// a type this server doesn't know would go into the chunk, the journal and every client's world
+	if (edit.type >= Block::BlockRegistry::getInstance().size()) {
+		stats.editsRejected++;
+		return;
+	}
+
+	ivec3 coords(Noise::floorDiv(position.x, CHUNK_MAX_X), position.y / CHUNK_MAX_Y, Noise::floorDiv(position.z, CHUNK_MAX_Z));
+	ivec3 inChunk = position - coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+
+	// clients only edit what they can see, anything else would have the server generate chunks wherever it is told
+	if (client.sent.find(coords) == client.sent.end()) {
+		stats.editsRejected++;
+		return;
+	}
+
+	Chunk& chunk = getChunk(coords);
+	if (chunk.getBlock(inChunk) == edit.type) return;
+
+	if (edit.type == 0) chunk.removeBlock(inChunk);
+	else chunk.placeBlock(inChunk, edit.type);
+	if (journal) journal->record(coords, inChunk, edit.type);
+	else unjournaled.insert(coords);
+	stats.edits++;
+
+	// a delta counts its changes in 16 bits
+	if (pendingDeltas[coords].changes.size() == UINT16_MAX) sendDeltas();
+
+	Protocol::Delta& delta = pendingDeltas[coords];
+	delta.coords = coords;
+	delta.changes.push_back({ inChunk, edit.type });
+}
+
+void ChunkServer::sendDeltas() {
+	for (const auto& [coords, delta] : pendingDeltas) {
+		vector<uint8_t> payload = delta.encode();
+		for (auto& client : clients) {
+			// clients that haven't been sent the chunk get the edited blocks along with it
+			if (client->sent.find(coords) == client->sent.end()) continue;
+			client->connection.send(Net::MessageType::DELTA, payload);
+			stats.deltasSent++;
+			stats.deltaBytes += payload.size();
+		}
+	}
+	pendingDeltas.clear();
+}
+
+void ChunkServer::sendChunks(Client& client) {
+	while (!client.toSend.empty() && client.connection.pendingBytes() < SEND_HIGH_WATER) {
+		PROFILE_SCOPE("ChunkServer::sendChunk");
+		ivec3 coords = client.toSend.back();
+		client.toSend.pop_back();
+
+		// heightmap chunks compress without materializing their blocks for good
+		Protocol::ChunkData chunk{ coords, getChunk(coords).compressBlocks() };
+		vector<uint8_t> payload = chunk.encode();
+		client.connection.send(Net::MessageType::CHUNK, payload);
+		client.sent.insert(coords);
+
+		stats.chunksSent++;
+		stats.chunkBytes += payload.size();
+	}
+}
+
+void ChunkServer::compactJournal() {
+	if (journal) journal->compact();
+}
+
+void ChunkServer::printStats(std::ostream& os) const {
+	os << "Server: " << clients.size() << " clients (" << stats.connections << " connected so far), "
+		<< chunks.size() << " chunks, " << stats.chunksGenerated << " generated, " << stats.chunksEvicted << " evicted\n";
+	os << "Sent: " << stats.chunksSent << " chunks, "
+		<< (stats.chunksSent ? stats.chunkBytes / stats.chunksSent : 0) << " bytes per chunk against "
+		<< sizeof(Block::BlockType) * CHUNK_MAX_X * CHUNK_MAX_Y * CHUNK_MAX_Z << " raw, "
+		<< stats.edits << " edits (" << stats.editsRejected << " rejected) in " << stats.deltasSent << " deltas, "
+		<< (stats.deltasSent ? stats.deltaBytes / stats.deltasSent : 0) << " bytes per delta\n";
+	if (journal) journal->printStats(os);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "chunk.h"
+#include "journal.h"
+#include "net.h"
+#include "protocol.h"
+#include "vecn_hash.hpp"
+
+using glm::ivec3;
+using std::vector;
+
+// chunks stop being queued for a client while this much is waiting to be sent to it
+// a client that stops reading fills it and the server stops generating for it
+static constexpr size_t SEND_HIGH_WATER = 256 * 1024;
+
+// subscriptions are clamped to this radius
+static constexpr int MAX_SUBSCRIBE_RADIUS = 32;
+
+/*
+Headless half of a split world: generates chunks, applies edits and streams both to render clients
+Clients subscribe to a box of chunks around them and are sent every chunk in it they
+haven't had yet, nearest first, run length encoded. Edits are applied here and every client
+holding the chunk gets the changed blocks as a delta, the editor included, so all of them agree.
+Clients are never sent light, they light the blocks themselves
+*/
+class ChunkServer
+{
+public:
+	// persistEdits keeps edits in the same journal a local world of the seed uses
+	ChunkServer(uint32_t seed, bool useDensityTerrain, bool persistEdits = true);
+
+	// false if the port is taken
+	bool listen(uint16_t port = DEFAULT_PORT);
+
+	// waits up to timeoutMillis for a socket to be ready, then accepts clients,
+	// handles their messages and sends what fits under SEND_HIGH_WATER
+	void step(int timeoutMillis);
+
+	// steps until stop is set
+	void run(const std::atomic<bool>& stop);
+
+	inline size_t clientCount() const {
+		return clients.size();
+	}
+
+	inline uint64_t getChunksSent() const {
+		return stats.chunksSent;
+	}
+
+	// writes the journal's log out to the chunks' deltas, so the next start has nothing to replay
+	void compactJournal();
+
+	void printStats(std::ostream& os) const;
+
+private:
+	struct Client {
+		explicit Client(Net::Connection connection) : connection(std::move(connection)) {}
+
+		Net::Connection connection;
+		std::optional<Protocol::Subscribe> subscription;
+
+		// chunks in the box the client has and gets deltas for, those that leave the box are sent whole again on return
+		std::unordered_set<ivec3, vec3Hash> sent;
+
+		// subscribed chunks not sent yet, farthest first so the nearest is popped off the back
+		vector<ivec3> toSend;
+	};
+
+	uint32_t seed;
+	ChunkMap chunks;
+	Noise::TileCache noiseTiles;
+	std::optional<Density::Plan> densityTerrain;
+	std::optional<EditJournal> journal;
+
+	std::optional<Net::Listener> listener;
+	vector<std::unique_ptr<Client>> clients;
+
+	// blocks changed this step, sent to clients at the end of it
+	std::unordered_map<ivec3, Protocol::Delta, vec3Hash> pendingDeltas;
+
+	// without a journal an edited chunk holds the only copy of its edits, so it is never evicted
+	std::unordered_set<ivec3, vec3Hash> unjournaled;
+
+	struct Stats {
+		uint64_t connections = 0;
+		uint64_t chunksGenerated = 0;
+		uint64_t chunksEvicted = 0;
+		uint64_t chunksSent = 0;
+		uint64_t chunkBytes = 0; // payloads only, before framing
+		uint64_t edits = 0;
+		uint64_t editsRejected = 0;
+		uint64_t deltasSent = 0;
+		uint64_t deltaBytes = 0;
+	} stats;
+
+	// generates it on first use, coords must be inside the world
+	Chunk& getChunk(ivec3 coords);
+
+	void handle(Client& client, const Net::Message& message);
+
+	// queues every chunk of the new box the client hasn't been sent, nearest first, and forgets those outside it
+	void subscribe(Client& client, Protocol::Subscribe subscription);
+
+	// drops the chunks outside every client's box, the journal puts their edits back if they are generated again
+	void evictChunks();
+
+	// only in chunks the client has been sent, of types the registry knows
+	void edit(Client& client, const Protocol::Edit& edit);
+
+	void sendDeltas();
+
+	// serialises queued chunks until the client's outgoing buffer reaches SEND_HIGH_WATER
+	void sendChunks(Client& client);
+};
@@ -1,43 +1,54 @@
 #version 330 core
 
-struct Material {
-    sampler2D diffuse;
-	sampler2D specular;
-    float shininess;
-}; 
-
-struct Light {
-    vec3 direction;
-  
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
+// per frame data, see uniformbuffer.h
+layout (std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 lightDirection;
+	vec4 lightAmbient;
+	vec4 lightDiffuse;
+	vec4 lightSpecular;
+	vec4 materialParams; // x = shininess
 };
 
-uniform Material material;
-uniform Light light;  
-
 in vec3 fragPos;
 in vec3 normal;
 in vec2 texCoord;
+flat in int layer;
+in float skyLight;
+in float blockLight;
 
 out vec4 colour;
 
-uniform sampler2D texture1;
+// one layer per block texture, the same texel is used for diffuse and specular
+uniform sampler2DArray blockTextures;
+
+// every level a cell is from its light source dims it by the same factor
+float lightFalloff(float level) {
+	return pow(0.8, 15.0 - level);
+}
 
 void main() {
-	vec3 ambient = light.ambient * texture(material.diffuse, texCoord).rgb;
+	vec3 texel = texture(blockTextures, vec3(texCoord, layer)).rgb;
+
+	// the sun only reaches faces with sky light, block light adds a warm glow on top
+	float sky = lightFalloff(skyLight);
+	float glow = blockLight > 0.0 ? lightFalloff(blockLight) : 0.0;
+
+	vec3 ambient = lightAmbient.rgb * texel * max(sky, glow);
 
 	vec3 norm = normalize(normal);
-	vec3 lightDir = normalize(-light.direction);
+	vec3 lightDir = normalize(-lightDirection.xyz);
 	float diff = max(dot(norm, lightDir), 0.0);
-	vec3 diffuse = light.diffuse * diff * texture(material.diffuse, texCoord).rgb;
+	vec3 diffuse = lightDiffuse.rgb * diff * texel * sky;
 
 	vec3 viewDir = normalize(-fragPos);
 	vec3 reflectDir = reflect(-lightDir, norm);
-	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-	vec3 specular = light.specular * spec * texture(material.specular, texCoord).rgb;  
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), materialParams.x);
+	vec3 specular = lightSpecular.rgb * spec * texel * sky;
+
+	vec3 emitted = vec3(1.0, 0.85, 0.6) * texel * glow * 0.6;
 
-	vec3 result = (ambient + diffuse + specular);
+	vec3 result = (ambient + diffuse + specular + emitted);
 	colour = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -2,14 +2,31 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in ivec3 aBlockData; // block type, face, light
+
+// per frame data, see uniformbuffer.h
+layout (std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	vec4 lightDirection;
+	vec4 lightAmbient;
+	vec4 lightDiffuse;
+	vec4 lightSpecular;
+	vec4 materialParams;
+};
 
 out vec3 fragPos;
 out vec3 normal;
 out vec2 texCoord;
+flat out int layer;
+out float skyLight;
+out float blockLight;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// texture array layer for each (block type, face), four to an ivec4, see uploadFaceLayers
+const int MAX_BLOCK_TYPES = 64;
+uniform ivec4 faceLayers[MAX_BLOCK_TYPES * 6 / 4];
 
 void main() {
    gl_Position = projection * view * model * vec4(aPos, 1.0);
@@ -17,4 +34,11 @@ void main() {
    fragPos = vec3(view * model * vec4(aPos, 1.0));
    normal = mat3(transpose(inverse(view * model))) * aNormal;
    texCoord = aTexCoord;
+
+   int entry = aBlockData.x * 6 + aBlockData.y;
+   layer = faceLayers[entry >> 2][entry & 3];
+
+   // levels 0 to 15, see light.h
+   skyLight = float(aBlockData.z >> 4);
+   blockLight = float(aBlockData.z & 15);
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+/*
+Per frame data shared by every program through one uniform buffer
+Must match the std140 "Frame" block in shader.vs and shader.fs: only mat4 and vec4 members,
+so the C++ layout and std140 agree without any padding
+*/
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 lightDirection; // view space
+	glm::vec4 lightAmbient;
+	glm::vec4 lightDiffuse;
+	glm::vec4 lightSpecular;
+	glm::vec4 material; // x = shininess
+};
+
+static constexpr unsigned int FRAME_UNIFORMS_BINDING = 0;
+
+// A uniform buffer object written once per frame and bound to a fixed binding point
+class UniformBuffer
+{
+public:
+	UniformBuffer(size_t size, unsigned int binding) : size(size) {
+		glGenBuffers(1, &UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, binding, UBO);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	~UniformBuffer() {
+		glDeleteBuffers(1, &UBO);
+	}
+
+	UniformBuffer(const UniformBuffer&) = delete;
+	UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+	void update(const void* data) const {
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+private:
+	unsigned int UBO = 0;
+	size_t size;
+};
@@ -0,0 +1,126 @@
+#include "uploader.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "profiler.h"
+
+// ARB_buffer_storage isn't part of the 3.3 core loader
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+using BufferStorageProc = void (APIENTRYP)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+void Uploader::init() {
+	initialised = true;
+
+	BufferStorageProc bufferStorage = nullptr;
+	if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+		bufferStorage = reinterpret_cast<BufferStorageProc>(glfwGetProcAddress("glBufferStorage"));
+	if (!bufferStorage) {
+		std::cout << "ARB_buffer_storage unsupported, uploading meshes with glBufferSubData" << std::endl;
+		return;
+	}
+
+	// coherent, so writes are visible to copies issued after them without flushing
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &ring);
+	glBindBuffer(GL_COPY_READ_BUFFER, ring);
+	bufferStorage(GL_COPY_READ_BUFFER, UPLOAD_RING_BYTES, nullptr, flags);
+	mapped = static_cast<char*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, UPLOAD_RING_BYTES, flags));
+
+	if (!mapped) {
+		std::cout << "Failed to map the upload ring, uploading meshes with glBufferSubData" << std::endl;
+		glDeleteBuffers(1, &ring);
+		ring = 0;
+	}
+}
+
+void Uploader::beginFrame() {
+	frameBytes = 0;
+
+	size_t passed = 0;
+	while (passed < inFlight.size()) {
+		GLenum status = glClientWaitSync(inFlight[passed].fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+		passed++;
+	}
+	retire(passed);
+}
+
+void Uploader::upload(GLuint destination, const void* data, GLsizeiptr size) {
+	PROFILE_SCOPE("Uploader::upload");
+	if (!initialised) init();
+	if (size == 0) return;
+
+	stats.uploads++;
+	stats.bytes += size;
+	frameBytes += size;
+
+	if (!mapped || size > UPLOAD_RING_BYTES) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, 0, size, data);
+		stats.fallbacks++;
+		return;
+	}
+
+	GLsizeiptr offset = allocate(size);
+	std::memcpy(mapped + offset, data, size);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, ring);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, size);
+	inFlight.push_back({ offset, offset + size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+}
+
+GLsizeiptr Uploader::allocate(GLsizeiptr size) {
+	// a region never wraps, the tail that doesn't fit is skipped
+	GLsizeiptr begin = head + size <= UPLOAD_RING_BYTES ? head : 0;
+	GLsizeiptr end = begin + size;
+	head = end;
+
+	// fences pass in the order they were issued, so waiting on the newest overlapping region frees every older one too
+	size_t overlapping = 0;
+	for (size_t i = 0; i < inFlight.size(); i++) {
+		if (inFlight[i].begin < end && begin < inFlight[i].end) overlapping = i + 1;
+	}
+	if (overlapping == 0) return begin;
+
+	GLsync fence = inFlight[overlapping - 1].fence;
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+		PROFILE_SCOPE("Uploader::stall");
+		const auto start = std::chrono::steady_clock::now();
+		do {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (status == GL_TIMEOUT_EXPIRED);
+
+		stats.stalls++;
+		stats.stallMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+	retire(overlapping);
+	return begin;
+}
+
+void Uploader::retire(size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		glDeleteSync(inFlight.front().fence);
+		inFlight.pop_front();
+	}
+}
+
+void Uploader::reportMemory(MemoryReport& report) const {
+	report.add("gpu", "uploadRingBytes", ring != 0 ? UPLOAD_RING_BYTES : 0);
+	report.add("gpu", "uploadsInFlight", inFlight.size());
+}
+
+void Uploader::printStats(std::ostream& os) const {
+	os << "Uploads: " << stats.uploads << " (" << stats.bytes / (1024 * 1024) << "MB), "
+		<< stats.fallbacks << " without the ring, " << stats.stalls << " stalls ("
+		<< stats.stallMicros / 1000.0 << "ms), " << inFlight.size() << " in flight\n";
+}
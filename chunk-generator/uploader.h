@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+
+#include "memory.h"
+
+/*
+Streams mesh uploads through one persistently mapped ring buffer
+Meshes are written straight into mapped memory and copied into their own buffers on the GPU,
+so the driver never has to reallocate or wait on a buffer that is still being drawn from.
+Every copy is followed by a fence and its part of the ring is only reused once the fence has passed.
+Without ARB_buffer_storage uploads fall back to glBufferSubData
+*/
+
+static constexpr GLsizeiptr UPLOAD_RING_BYTES = 16 << 20;
+static constexpr GLsizeiptr UPLOAD_FRAME_BUDGET = 4 << 20; // bytes uploaded per frame before uploads wait for the next
+
+class Uploader // Singleton
+{
+public:
+	struct Stats {
+		uint64_t uploads = 0;
+		uint64_t bytes = 0;
+		uint64_t fallbacks = 0; // uploads that went through glBufferSubData instead of the ring
+		uint64_t stalls = 0; // times the ring was full and the CPU waited on a fence
+		int64_t stallMicros = 0;
+	};
+
+	static Uploader& getInstance() {
+		static Uploader instance;
+		return instance;
+	}
+
+	// resets the frame budget and releases the parts of the ring the GPU is done with
+	void beginFrame();
+
+	inline bool hasBudget() const {
+		return frameBytes < UPLOAD_FRAME_BUDGET;
+	}
+
+	// copies size bytes of data to the start of destination, which must already have room for them
+	// needs a current GL context
+	void upload(GLuint destination, const void* data, GLsizeiptr size);
+
+	inline const Stats& getStats() const {
+		return stats;
+	}
+
+	void printStats(std::ostream& os) const;
+
+	void reportMemory(MemoryReport& report) const;
+
+private:
+	// part of the ring a copy is still reading from
+	struct Region {
+		GLsizeiptr begin, end;
+		GLsync fence;
+	};
+
+	// created on the first upload, when there is sure to be a context
+	// ring stays 0 when persistent mapping isn't supported
+	bool initialised = false;
+	GLuint ring = 0;
+	char* mapped = nullptr;
+
+	GLsizeiptr head = 0;
+	std::deque<Region> inFlight; // oldest first
+	GLsizeiptr frameBytes = 0;
+
+	Stats stats;
+
+	Uploader() = default;
+
+	void init();
+
+	// returns the offset of size free bytes in the ring, waiting on fences if needed
+	GLsizeiptr allocate(GLsizeiptr size);
+
+	// drops the first count regions of inFlight
+	void retire(size_t count);
+};
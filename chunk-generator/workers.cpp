@@ -0,0 +1,72 @@
+#include "workers.h"
+
+#include <algorithm>
+
+unsigned WorkerPool::defaultThreadCount() {
+	return std::max(1u, std::thread::hardware_concurrency() - 1);
+}
+
+WorkerPool::WorkerPool(unsigned threadCount) {
+	threads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; i++) threads.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobReady.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
+
+void WorkerPool::submit(Job job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	submitted++;
+	jobReady.notify_one();
+}
+
+size_t WorkerPool::finishCompleted() {
+	std::deque<Finish> ready;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(done);
+	}
+
+	// finishes may submit more jobs, so they run outside the lock
+	for (Finish& finish : ready) {
+		finished++;
+		if (finish) finish();
+	}
+	return ready.size();
+}
+
+void WorkerPool::waitForAny() {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (submitted - finished == done.size()) return;
+	jobDone.wait(lock, [this]() { return !done.empty(); });
+}
+
+void WorkerPool::work() {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		Finish finish = job();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.push_back(std::move(finish));
+		}
+		jobDone.notify_all();
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+/*
+A fixed set of threads for chunk work that doesn't need the world
+A job runs on a worker and returns its finish, which runs on the main thread the next time
+finished jobs are collected, so only the main thread ever changes the world.
+Jobs only read what they captured, like snapshots, never anything the main thread may change
+*/
+class WorkerPool
+{
+public:
+	using Finish = std::function<void()>;
+	using Job = std::function<Finish()>;
+
+	// one less than the cores, so the main thread keeps one to itself
+	static unsigned defaultThreadCount();
+
+	explicit WorkerPool(unsigned threadCount = defaultThreadCount());
+
+	// waits for running jobs, queued ones and their finishes are dropped
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void submit(Job job);
+
+	// runs the finish of every job done so far, returns how many
+	size_t finishCompleted();
+
+	// blocks until a job is done, returns straight away if none are queued or running
+	void waitForAny();
+
+	// submitted and not finished yet, queued or running or waiting on finishCompleted
+	inline size_t inFlight() const {
+		return submitted - finished;
+	}
+
+	inline size_t threadCount() const {
+		return threads.size();
+	}
+
+private:
+	vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	std::deque<Job> jobs;
+	std::deque<Finish> done;
+	bool stopping = false;
+
+	// main thread only
+	size_t submitted = 0;
+	size_t finished = 0;
+
+	void work();
+};
@@ -1,101 +1,806 @@
 #include "world.h"
 
-World::World(uint32_t seed) : seed(seed) {
-	if (seed == UINT32_MAX) {
-		std::random_device rd;
-		seed = rd();
-	}
-
-	loadChunks({ 0, 0 });
-	update(2 * RENDER_DISTANCE * RENDER_DISTANCE);
-}
-
-void World::loadChunks(glm::ivec2 playerChunk) {
-	for (int x = playerChunk.x - RENDER_DISTANCE / 2; x <= playerChunk.x + RENDER_DISTANCE / 2; x++) {
-		for (int z = playerChunk.y - RENDER_DISTANCE / 2; z <= playerChunk.y + RENDER_DISTANCE / 2; z++) {
-			glm::ivec2 coords(x, z);
-			bool inWorld = chunks.find(coords) != chunks.end();
-			bool inQueue = toLoadAdded.find(coords) != toLoadAdded.end();
-			if (!inWorld && !inQueue) {
-				int squaredDist = (playerChunk.x - coords.x) * (playerChunk.x - coords.x) + (playerChunk.y - coords.y) * (playerChunk.y - coords.y);
-				toLoad.push({coords, squaredDist});
-				toLoadAdded.insert(coords);
+#include "chunkpool.h"
+#include "client.h"
+#include "uploader.h"
+
+World::World(uint32_t seed, bool useDensityTerrain, bool blockingStartup, bool persistEdits) : seed(seed == UINT32_MAX ? std::random_device{}() : seed),
+	noiseTiles(this->seed, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES, NOISE_TILES),
+	meshCache("saves/" + std::to_string(this->seed) + "/meshes") {
+	ChunkPool::getInstance().setCapacity(CHUNK_POOL_SLOTS);
+	if (useDensityTerrain) densityTerrain = buildDensityTerrain(this->seed);
+	if (persistEdits) journal.emplace(EditJournal::directoryFor(this->seed, useDensityTerrain));
+
+	loadChunks(SPAWN_CHUNK);
+	if (blockingStartup)
+		updateUntil([this]() { return !hasPendingWork(); });
+	else
+		loadSpawn(SPAWN_CHUNK);
+}
+
+World::World(ChunkClient& remote) : seed(0), remote(&remote),
+	noiseTiles(seed, CHUNK_MAX_X, CHUNK_MAX_Z, NOISE_OCTAVES, INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_STRIDES, NOISE_TILES),
+	meshCache("saves/remote/meshes") {
+	ChunkPool::getInstance().setCapacity(CHUNK_POOL_SLOTS);
+	loadChunks(SPAWN_CHUNK);
+}
+
+Density::Plan World::buildDensityTerrain(uint32_t seed) {
+	Density::Graph graph;
+
+	// height above the heightmap surface, negative in the air
+	int hills = graph.noise2D(INITIAL_FREQUENCY, INITIAL_AMPLITUDE, NOISE_OCTAVES);
+	int baseline = graph.yGradient(0.0f, HEIGHT_BASELINE, WORLD_HEIGHT, HEIGHT_BASELINE - WORLD_HEIGHT);
+	int surface = graph.add(hills, baseline);
+
+	// 3D noise pushes the surface around enough to make overhangs
+	int overhangs = graph.add(surface, graph.noise3D(24.0f, 10.0f, 1, 1));
+
+	// carve where cave noise is near its extremes, fading out towards the surface so caves rarely break through
+	int caveNoise = graph.noise3D(16.0f, 1.0f, 2, 2);
+	int caves = graph.spline(caveNoise, { {-1.0f, -64.0f}, {-0.4f, 0.0f}, {0.4f, 0.0f}, {1.0f, -64.0f} });
+	int depth = graph.clamp(graph.mul(surface, graph.constant(1.0f / 8.0f)), 0.0f, 1.0f);
+
+	int density = graph.add(overhangs, graph.mul(caves, depth));
+	return graph.compile(density, seed);
+}
+
+void World::loadChunks(ivec3 playerChunk) {
+	if (loadCenter == playerChunk) return;
+	PROFILE_SCOPE("World::loadChunks");
+
+	constexpr int radius = RENDER_DISTANCE / 2;
+
+	// calls f for every chunk in the box around center that isn't in the box around other,
+	// walking only the strips between them, nothing above or below the world is loaded
+	auto forEachOutside = [](ivec3 center, std::optional<ivec3> other, auto&& f) {
+		const int bottom = std::max(center.y - VERTICAL_RADIUS, 0);
+		const int top = std::min(center.y + VERTICAL_RADIUS, WORLD_CHUNKS_Y - 1);
+		for (int x = center.x - radius; x <= center.x + radius; x++) {
+			for (int y = bottom; y <= top; y++) {
+				bool shared = other && std::abs(x - other->x) <= radius && std::abs(y - other->y) <= VERTICAL_RADIUS;
+				for (int z = center.z - radius; z <= center.z + radius; z++) {
+					if (shared && std::abs(z - other->z) <= radius) {
+						z = other->z + radius; // jump past the shared run
+						continue;
+					}
+					f(ivec3(x, y, z));
+				}
 			}
 		}
+	};
+
+	if (loadCenter) {
+		forEachOutside(*loadCenter, playerChunk, [this](ivec3 coords) {
+			// generated chunks keep their start time, they are still on the way to the screen
+			if (toLoadAdded.erase(coords)) loadStarted.erase(coords);
+		});
+	}
+
+	forEachOutside(playerChunk, loadCenter, [this, playerChunk](ivec3 coords) {
+		bool inWorld = chunks.find(coords) != chunks.end() || progress.find(coords) != progress.end();
+		bool inQueue = toLoadAdded.find(coords) != toLoadAdded.end();
+		if (!inWorld && !inQueue) {
+			// the server orders a remote world's chunks itself
+			if (!remote) {
+				toLoad.push_back({ coords, chunkPriority(coords) });
+				std::push_heap(toLoad.begin(), toLoad.end(), ChunkTaskCompare{});
+			}
+			toLoadAdded.insert(coords);
+			loadStarted.emplace(coords, std::chrono::steady_clock::now());
+		}
+	});
+
+	if (remote) remote->subscribe(playerChunk, radius, VERTICAL_RADIUS);
+
+	loadCenter = playerChunk;
+	updateResidency(playerChunk);
+}
+
+void World::skipCancelled() {
+	while (!toLoad.empty() && toLoadAdded.find(toLoad.front().coords) == toLoadAdded.end()) {
+		std::pop_heap(toLoad.begin(), toLoad.end(), ChunkTaskCompare{});
+		toLoad.pop_back();
 	}
 }
 
-void World::update(int numChunks) {
-	for (int i = 0; i < numChunks; i++) {
-		if (toLoad.empty()) return;
-		ivec2 loadNow = toLoad.top().coords;
-		toLoad.pop();
+void World::setViewer(const Viewer& newViewer) {
+	viewer = newViewer;
+
+	vec3 scoredAhead = scoredViewer.position + scoredViewer.velocity * LOOKAHEAD_SECONDS;
+	vec3 ahead = viewer.position + viewer.velocity * LOOKAHEAD_SECONDS;
+	float turnCos = glm::dot(glm::normalize(scoredViewer.front), glm::normalize(viewer.front));
+
+	if (glm::distance(scoredAhead, ahead) > RESCORE_DISTANCE || turnCos < std::cos(glm::radians(RESCORE_ANGLE)))
+		rescoreLoadQueue();
+}
+
+float World::chunkPriority(ivec3 coords) const {
+	const vec3 chunkSize(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+	vec3 center = (vec3(coords) + 0.5f) * chunkSize;
 
-		if (chunks.find(loadNow) == chunks.end())
-			chunks.emplace(loadNow, std::make_unique<Chunk>(seed, loadNow.x, loadNow.y));
-		toLoadAdded.erase(loadNow);
+	vec3 ahead = viewer.position + viewer.velocity * LOOKAHEAD_SECONDS;
+	vec3 toAhead = (center - ahead) / chunkSize;
+	float priority = glm::dot(toAhead, toAhead);
+
+	// off screen chunks wait behind everything on screen, apart from the ones right around the player
+	constexpr float offscreenPenalty = 4.0f * RENDER_DISTANCE * RENDER_DISTANCE;
+	if (!isWanted(coords)) priority += offscreenPenalty;
+
+	return priority;
+}
+
+bool World::isWanted(ivec3 coords) const {
+	const vec3 chunkSize(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+	vec3 toPlayer = ((vec3(coords) + 0.5f) * chunkSize - viewer.position) / chunkSize;
+	return glm::dot(toPlayer, toPlayer) <= 1.5f * 1.5f || isVisible(coords);
+}
+
+void World::rescoreLoadQueue() {
+	PROFILE_SCOPE("World::rescoreLoadQueue");
+	scoredViewer = viewer;
+
+	// cancelled tasks are dropped here instead of waiting to reach the top
+	toLoad.erase(std::remove_if(toLoad.begin(), toLoad.end(), [this](const ChunkTask& task) {
+		return toLoadAdded.find(task.coords) == toLoadAdded.end();
+	}), toLoad.end());
+
+	for (ChunkTask& task : toLoad) task.priority = chunkPriority(task.coords);
+	std::make_heap(toLoad.begin(), toLoad.end(), ChunkTaskCompare{});
+}
+
+void World::trackVisibleLoad() {
+	auto anyVisible = [this](const auto& coordsList) {
+		return std::any_of(coordsList.begin(), coordsList.end(), [this](ivec3 coords) { return isVisible(coords); });
+	};
+	bool complete = !anyVisible(toLoadAdded) && std::none_of(progress.begin(), progress.end(), [this](const auto& entry) {
+		return isVisible(entry.first);
+	});
+
+	const auto now = std::chrono::steady_clock::now();
+	if (!complete) {
+		if (!visibleIncompleteSince) visibleIncompleteSince = now;
+	}
+	else if (visibleIncompleteSince) {
+		visibleLoad.add(std::chrono::duration_cast<std::chrono::microseconds>(now - *visibleIncompleteSince).count());
+		visibleIncompleteSince.reset();
 	}
 }
 
-const void World::draw(Shader & shader, glm::ivec2 playerChunk) {
+void World::updateResidency(ivec3 playerChunk) {
+	for (auto it = hot.begin(); it != hot.end();) {
+		const ivec3 coords = *it;
+		int distance = std::max(std::abs(coords.x - playerChunk.x), std::abs(coords.z - playerChunk.z));
+		int height = std::abs(coords.y - playerChunk.y);
+		if (distance <= COLD_DISTANCE && height <= COLD_VERTICAL_DISTANCE) {
+			++it;
+			continue;
+		}
+
+		chunks.at(coords)->freeze();
+		progress.erase(coords); // a mesh still on a worker is dropped when it finishes
+		promotions.erase(coords);
+		residency.freezes++;
+		it = hot.erase(it);
+	}
+
+	// only chunks in the view box thaw, so that is all that needs looking at
+	for (int x = -RENDER_DISTANCE / 2; x <= RENDER_DISTANCE / 2; x++) {
+		for (int y = -VERTICAL_RADIUS; y <= VERTICAL_RADIUS; y++) {
+			for (int z = -RENDER_DISTANCE / 2; z <= RENDER_DISTANCE / 2; z++) {
+				const ivec3 coords = playerChunk + ivec3(x, y, z);
+				auto found = chunks.find(coords);
+				if (found == chunks.end() || !found->second->isCold()) continue;
+
+				found->second->thaw();
+				hot.insert(coords);
+				queueMesh(coords);
+				promotions[coords] = std::chrono::steady_clock::now();
+				residency.thaws++;
+			}
+		}
+	}
+}
+
+int World::update(int budgetMicros) {
+	PROFILE_SCOPE("World::update");
+	using Clock = std::chrono::steady_clock;
+	const auto start = Clock::now();
+
+	auto elapsedMicros = [&start]() {
+		return static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+	};
+
+	if (remote) {
+		remote->poll();
+		applyRemoteDeltas();
+	}
+
+	// generated chunks join the world and meshes are taken before anything looks at progress
+	workers.finishCompleted();
+
+	for (auto& stageReady : ready) stageReady.clear();
+	for (const auto& [coords, entry] : progress) {
+		if (!entry.running && isReady(coords, entry.stage)) ready[entry.stage].push_back({ chunkPriority(coords), coords });
+	}
+
+	// nothing decorates yet, chunks pass straight through
+	for (const auto& [priority, coords] : ready[DECORATE]) {
+		completeStage(coords, progress.at(coords));
+		if (isReady(coords, LIGHT)) ready[LIGHT].push_back({ priority, coords });
+	}
+
+	for (Stage stage : { LIGHT, MESH, UPLOAD }) {
+		std::sort(ready[stage].begin(), ready[stage].end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	}
+
+	// a couple of jobs per worker keeps them busy between updates without holding finishes back long
+	// meshes go first, they finish chunks already in flight
+	const size_t maxJobs = 2 * workers.threadCount();
+	for (const auto& [priority, coords] : ready[MESH]) {
+		if (workers.inFlight() >= maxJobs) break;
+		startMeshing(coords);
+	}
+
+	// the server generates a remote world's chunks
+	while (!remote && workers.inFlight() < maxJobs) {
+		ivec3 coords;
+		if (!urgentLoads.empty()) {
+			coords = urgentLoads.front();
+			urgentLoads.pop_front();
+			if (toLoadAdded.find(coords) == toLoadAdded.end()) continue;
+		}
+		else {
+			skipCancelled();
+			if (toLoad.empty()) break;
+			coords = toLoad.front().coords;
+			std::pop_heap(toLoad.begin(), toLoad.end(), ChunkTaskCompare{});
+			toLoad.pop_back();
+		}
+		startGenerating(coords);
+	}
+
+	// then the main thread stages by their estimated costs, uploads first
+	// the first one of a call always runs so a chunk costlier than the budget can't stall the pipeline
+	size_t taken[STAGE_COUNT] = {};
+	bool first = true;
+	while (budgetMicros > 0) {
+		int elapsed = elapsedMicros();
+
+		Stage next = STAGE_COUNT;
+		for (Stage stage : { UPLOAD, LIGHT, GENERATE }) {
+			bool hasWork = stage == GENERATE ? remote && remote->nextIsChunk() : taken[stage] < ready[stage].size();
+			if (stage == UPLOAD) hasWork = hasWork && Uploader::getInstance().hasBudget();
+			if (hasWork && (first || elapsed + stageCost[stage] <= budgetMicros)) {
+				next = stage;
+				break;
+			}
+		}
+		if (next == STAGE_COUNT) break;
+
+		int stageStart = elapsedMicros();
+		if (next == GENERATE) {
+			receiveChunk();
+		}
+		else {
+			// lighting can send chunks that were ready to upload back to MESH
+			ivec3 coords = ready[next][taken[next]++].second;
+			auto entry = progress.find(coords);
+			if (entry == progress.end() || entry->second.stage != next) continue;
+
+			if (next == LIGHT) lightChunk(coords);
+			else uploadChunk(coords);
+		}
+		stageCost[next] = 0.8f * stageCost[next] + 0.2f * (elapsedMicros() - stageStart);
+		first = false;
+	}
+
+	trackVisibleLoad();
+
+	int used = elapsedMicros();
+	if (budgetMicros != std::numeric_limits<int>::max()) {
+		budgetUsed.add(used);
+		budgetGivenMicros += budgetMicros;
+		if (used > budgetMicros) budgetOverruns++;
+	}
+	return used;
+}
+
+void World::updateUntil(const std::function<bool()>& done) {
+	while (!done()) {
+		// each pass counts as a frame to the uploader, nothing is drawn in between
+		Uploader::getInstance().beginFrame();
+		update(std::numeric_limits<int>::max());
+		if (!done()) workers.waitForAny();
+	}
+}
+
+void World::loadSpawn(ivec3 center) {
+	PROFILE_SCOPE("World::loadSpawn");
+	// the cube and the chunks it waits on to mesh go first, rather than in queue order,
+	// which depends on where the camera looks
+	// chunks outside the world or the loaded box aren't queued, so they never hold it up
+	for (int x = center.x - SPAWN_RADIUS - 1; x <= center.x + SPAWN_RADIUS + 1; x++) {
+		for (int y = center.y + SPAWN_RADIUS + 1; y >= center.y - SPAWN_RADIUS - 1; y--) {
+			for (int z = center.z - SPAWN_RADIUS - 1; z <= center.z + SPAWN_RADIUS + 1; z++) {
+				if (toLoadAdded.find(ivec3(x, y, z)) != toLoadAdded.end()) urgentLoads.push_back(ivec3(x, y, z));
+			}
+		}
+	}
+
+	updateUntil([this, center]() {
+		for (int x = center.x - SPAWN_RADIUS; x <= center.x + SPAWN_RADIUS; x++) {
+			for (int y = center.y - SPAWN_RADIUS; y <= center.y + SPAWN_RADIUS; y++) {
+				for (int z = center.z - SPAWN_RADIUS; z <= center.z + SPAWN_RADIUS; z++) {
+					if (stageOf(ivec3(x, y, z)) != STAGE_COUNT) return false;
+				}
+			}
+		}
+		return true;
+	});
+}
+
+World::Stage World::stageOf(ivec3 coords) const {
+	auto found = progress.find(coords);
+	if (found != progress.end()) return found->second.stage;
+	if (toLoadAdded.find(coords) != toLoadAdded.end()) return GENERATE;
+	return STAGE_COUNT;
+}
+
+bool World::isReady(ivec3 coords, Stage stage) {
+	switch (stage) {
+		case DECORATE:
+			return neighboursPast(coords, GENERATE, DECORATE_REACH, true);
+		case LIGHT:
+			// sky light comes down from the section above, it is lit first
+			// not short circuited, so whatever either waits on is hurried
+			return neighboursPast(coords, DECORATE, DECORATE_REACH, true)
+				& isPast(coords + ivec3(0, 1, 0), LIGHT, !remote && isWanted(coords));
+		case MESH:
+			return neighboursPast(coords, LIGHT, 1, false);
+		case UPLOAD:
+			return Uploader::getInstance().hasBudget();
+		default:
+			return false; // generation starts from the load queue
+	}
+}
+
+bool World::neighboursPast(ivec3 coords, Stage stage, int reach, bool diagonals) {
+	bool hurry = !remote && isWanted(coords);
+	bool past = true;
+	for (int dx = -reach; dx <= reach; dx++) {
+		for (int dy = -reach; dy <= reach; dy++) {
+			for (int dz = -reach; dz <= reach; dz++) {
+				int axes = (dx != 0) + (dy != 0) + (dz != 0);
+				if (axes == 0 || (!diagonals && axes > 1)) continue;
+
+				// all of them are hurried, not just the first one found
+				past &= isPast(coords + ivec3(dx, dy, dz), stage, hurry);
+			}
+		}
+	}
+	return past;
+}
+
+bool World::isPast(ivec3 coords, Stage stage, bool hurry) {
+	if (stageOf(coords) > stage) return true;
+
+	if (hurry && toLoadAdded.find(coords) != toLoadAdded.end()
+		&& std::find(urgentLoads.begin(), urgentLoads.end(), coords) == urgentLoads.end())
+		urgentLoads.push_back(coords);
+	return false;
+}
+
+void World::completeStage(ivec3 coords, Progress& entry) {
+	const auto now = std::chrono::steady_clock::now();
+	stageLatency[entry.stage].add(std::chrono::duration_cast<std::chrono::microseconds>(now - entry.since).count());
+
+	entry.stage = Stage(entry.stage + 1);
+	entry.since = now;
+	if (entry.stage == STAGE_COUNT) progress.erase(coords);
+}
+
+void World::startGenerating(ivec3 coords) {
+	toLoadAdded.erase(coords);
+	progress[coords] = { GENERATE, true, false, std::chrono::steady_clock::now() };
+
+	// std::function needs a finish it can copy, so the chunk is carried in a shared holder
+	auto finish = [this, coords](std::unique_ptr<Chunk> chunk) -> WorkerPool::Finish {
+		auto holder = std::make_shared<std::unique_ptr<Chunk>>(std::move(chunk));
+		return [this, coords, holder]() { addChunk(coords, std::move(*holder)); };
+	};
+
+	uint32_t chunkSeed = seed;
+	if (densityTerrain) {
+		const Density::Plan* terrain = &*densityTerrain;
+		workers.submit([finish, chunkSeed, coords, terrain]() {
+			return finish(std::make_unique<Chunk>(chunkSeed, coords.x, coords.y, coords.z, *terrain));
+		});
+		return;
+	}
+
+	// the tile cache is main thread only, so the heights are sliced here
+	// every section of a column slices the same tile
+	vector<int> offsets;
+	noiseTiles.slice(coords.x, coords.z, offsets);
+	workers.submit([finish, chunkSeed, coords, offsets = std::move(offsets)]() {
+		return finish(std::make_unique<Chunk>(chunkSeed, coords.x, coords.y, coords.z, offsets));
+	});
+}
+
+void World::addChunk(ivec3 coords, std::unique_ptr<Chunk> chunk) {
+	if (journal) journal->apply(coords, *chunk);
+	staged.emplace(coords, std::move(chunk));
+
+	// received chunks skip the generate stage
+	auto entry = progress.find(coords);
+	if (entry == progress.end()) {
+		progress.emplace(coords, Progress{ DECORATE, false, false, std::chrono::steady_clock::now() });
+		return;
+	}
+	entry->second.running = false;
+	completeStage(coords, entry->second);
+}
+
+void World::receiveChunk() {
+	ChunkClient::Update update = remote->takeUpdate();
+	ivec3 coords = update.chunk.coords;
+	toLoadAdded.erase(coords);
+
+	auto stagedChunk = staged.find(coords);
+	if (stagedChunk != staged.end()) {
+		// not lit yet, the newer blocks simply take its place
+		stagedChunk->second = std::make_unique<Chunk>(coords.x, coords.y, coords.z, update.chunk.blocks);
+	}
+	else if (chunks.find(coords) != chunks.end()) {
+		applyDelta(diffBlocks(coords, Chunk(coords.x, coords.y, coords.z, update.chunk.blocks)));
+	}
+	else if (progress.find(coords) == progress.end()) {
+		addChunk(coords, std::make_unique<Chunk>(coords.x, coords.y, coords.z, update.chunk.blocks));
+	}
+	applyRemoteDeltas();
+}
+
+Protocol::Delta World::diffBlocks(ivec3 coords, const Chunk& received) {
+	Chunk& chunk = *chunks.at(coords);
+	bool cold = chunk.isCold();
+	if (cold) chunk.thaw();
+
+	Protocol::Delta delta;
+	delta.coords = coords;
+	for (int z = 0; z < CHUNK_MAX_Z; z++) {
+		for (int y = 0; y < CHUNK_MAX_Y; y++) {
+			for (int x = 0; x < CHUNK_MAX_X; x++) {
+				Block::BlockType type = received.getBlock({ x, y, z });
+				if (chunk.getBlock({ x, y, z }) != type) delta.changes.push_back({ ivec3(x, y, z), type });
+			}
+		}
+	}
+
+	if (cold) chunk.freeze();
+	return delta;
+}
+
+void World::lightChunk(ivec3 coords) {
+	auto found = staged.find(coords);
+	chunks.emplace(coords, std::move(found->second));
+	hot.insert(coords);
+	staged.erase(found);
+
+	// its light can reach into the neighbours, they remesh along with it
+	light.addChunk(coords);
+	for (ivec3 dirty : light.takeDirty()) {
+		if (dirty != coords) queueMesh(dirty);
+	}
+	completeStage(coords, progress.at(coords));
+}
+
+void World::startMeshing(ivec3 coords) {
+	progress.at(coords).running = true;
+
+	Chunk::Snapshot snapshot = chunks.at(coords)->snapshot();
+	Chunk::NeighbourSnapshots neighbourSnapshots;
+	Chunk::Neighbours neighbours = getNeighbours(coords);
+	for (int face = 0; face < 6; face++) {
+		if (neighbours[face] != nullptr) neighbourSnapshots[face] = neighbours[face]->snapshot();
+	}
+
+	MeshCache* cache = &meshCache;
+	workers.submit([this, coords, snapshot, neighbourSnapshots, cache]() -> WorkerPool::Finish {
+		auto vertices = std::make_shared<vector<Vertex>>(Chunk::meshSnapshot(snapshot, neighbourSnapshots, cache));
+		uint64_t builtFrom = snapshot.version;
+		return [this, coords, vertices, builtFrom]() { finishMesh(coords, std::move(*vertices), builtFrom); };
+	});
+}
+
+void World::finishMesh(ivec3 coords, vector<Vertex>&& vertices, uint64_t builtFrom) {
+	// frozen while it was meshing, thawing queues it again
+	auto entry = progress.find(coords);
+	if (entry == progress.end()) {
+		ChunkPool::getInstance().giveMesh(std::move(vertices));
+		return;
+	}
+	entry->second.running = false;
+
+	// it or a neighbour changed while it was meshing, it stays at MESH for another go
+	if (std::exchange(entry->second.remesh, false)) {
+		ChunkPool::getInstance().giveMesh(std::move(vertices));
+		return;
+	}
+	if (!chunks.at(coords)->acceptMesh(std::move(vertices), builtFrom)) return;
+	if (entry->second.stage == MESH) completeStage(coords, entry->second);
+}
+
+void World::uploadChunk(ivec3 coords) {
+	chunks.at(coords)->uploadMesh();
+
+	auto started = loadStarted.find(coords);
+	if (started != loadStarted.end()) {
+		chunkLoad.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started->second).count());
+		loadStarted.erase(started);
+	}
+
+	auto promotion = promotions.find(coords);
+	if (promotion != promotions.end()) {
+		int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - promotion->second).count();
+		residency.promotionsCompleted++;
+		residency.promotionMicros += micros;
+		residency.maxPromotionMicros = std::max(residency.maxPromotionMicros, micros);
+		promotions.erase(promotion);
+	}
+
+	completeStage(coords, progress.at(coords));
+}
+
+bool World::hasRemoteUpdates() const {
+	return remote && remote->hasUpdate();
+}
+
+void World::applyRemoteDeltas() {
+	while (remote->hasUpdate() && !remote->nextIsChunk()) applyDelta(remote->takeUpdate().delta);
+}
+
+void World::applyDelta(const Protocol::Delta& delta) {
+	const ivec3 origin = delta.coords * ivec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+
+	// staged chunks aren't lit yet, they only need the blocks
+	auto stagedChunk = staged.find(delta.coords);
+	if (stagedChunk != staged.end()) {
+		for (const Protocol::Delta::Change& change : delta.changes) {
+			if (change.type == 0) stagedChunk->second->removeBlock(change.coords);
+			else stagedChunk->second->placeBlock(change.coords, change.type);
+		}
+		return;
+	}
+
+	auto found = chunks.find(delta.coords);
+	if (found == chunks.end()) return;
+	Chunk& chunk = *found->second;
+
+	// cold chunks are thawed just long enough to take the change, the server won't send it again
+	bool cold = chunk.isCold();
+	if (cold) chunk.thaw();
+
+	for (const Protocol::Delta::Change& change : delta.changes) {
+		Block::BlockType oldType = chunk.getBlock(change.coords);
+		if (change.type == 0) chunk.removeBlock(change.coords);
+		else chunk.placeBlock(change.coords, change.type);
+		light.blockChanged(origin + change.coords, oldType);
+	}
+
+	if (cold) chunk.freeze();
+	remeshDirty();
+}
+
+const vector<const Chunk*>& World::cull(ivec3 playerChunk) {
+	PROFILE_SCOPE("World::cull");
+	drawList.clear();
+
+	// cold chunks are never drawn, so only the hot ones need looking at
+	for (ivec3 coords : hot) {
+		// in chunks, the same box the world loads around the player
+		const ivec3 offset = coords - playerChunk;
+		if (std::max(std::abs(offset.x), std::abs(offset.z)) > RENDER_DISTANCE / 2 || std::abs(offset.y) > VERTICAL_RADIUS)
+			continue;
+		if (!isVisible(coords))
+			continue;
+
+		drawList.push_back(chunks.at(coords).get());
+	}
+	return drawList;
+}
+
+const void World::draw(Shader & shader, ivec3 playerChunk) {
+	PROFILE_SCOPE("World::draw");
 	shader.use();
-	for (const auto& entry : chunks) {
-		const auto& coords = entry.first;
-		const auto& chunk = entry.second;
+	const int modelLocation = shader.getUniformLocation("model");
 
+	for (const Chunk* chunk : cull(playerChunk)) {
 		glm::vec3 chunkCoords = chunk->getModelCoords();
 
-		if (glm::distance(chunkCoords, glm::vec3(playerChunk.x, 0.0f, playerChunk.y)) > 0.5 * RENDER_DISTANCE * std::max(CHUNK_MAX_X, CHUNK_MAX_Z))
-			continue;
-	
 		glm::mat4 model(1.0f);
-		model = glm::translate(model, (float)CHUNK_MAX_X * chunkCoords);
-		shader.setMat4("model", model);
+		model = glm::translate(model, glm::vec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z) * chunkCoords);
+		shader.setMat4(modelLocation, model);
 		chunk->draw();
 	}
 }
 
-std::pair<ivec2, ivec3> World::findChunk(ivec3 worldPosition) const {
-	// should be the only out of bounds check (world is theoretically infinite along x and z)
-	if (worldPosition.y < 0 || worldPosition.y >= CHUNK_MAX_Y) throw std::out_of_range("Invalid y value");
+void World::printStats(std::ostream& os) const {
+	os << "Chunks: " << chunks.size() << " loaded, " << staged.size() << " staged, " << toLoadAdded.size() << " queued\n";
+
+	// waiting counts the load queue as waiting to generate
+	size_t waiting[STAGE_COUNT] = { toLoadAdded.size() }, running[STAGE_COUNT] = {};
+	for (const auto& entry : progress) (entry.second.running ? running : waiting)[entry.second.stage]++;
+	os << "Pipeline (waiting+running, time in stage):";
+	for (int stage = 0; stage < STAGE_COUNT; stage++) {
+		os << " " << STAGE_NAMES[stage] << " " << waiting[stage] << "+" << running[stage] << " "
+			<< stageLatency[stage].averageMillis() << "ms avg " << stageLatency[stage].maxMillis() << "ms max,";
+	}
+	os << " " << workers.threadCount() << " workers\n";
+
+	int hot = 0, cold = 0;
+	size_t hotBytes = 0, coldBytes = 0;
+	for (const auto& entry : chunks) {
+		const Chunk& chunk = *entry.second;
+		if (chunk.isCold()) {
+			cold++;
+			coldBytes += chunk.residentBytes();
+		}
+		else {
+			hot++;
+			hotBytes += chunk.residentBytes();
+		}
+	}
+	os << "Residency: " << hot << " hot (" << hotBytes / 1024 << "KB), " << cold << " cold (" << coldBytes / 1024 << "KB), "
+		<< residency.freezes << " frozen, " << residency.thaws << " thawed, promotion "
+		<< (residency.promotionsCompleted ? residency.promotionMicros / 1000.0 / residency.promotionsCompleted : 0.0) << "ms avg, "
+		<< residency.maxPromotionMicros / 1000.0 << "ms max\n";
+	os << "Chunk budget: " << budgetUsed.count << " frames, " << budgetUsed.averageMillis() << "ms avg ("
+		<< (budgetGivenMicros ? 100.0 * budgetUsed.totalMicros / budgetGivenMicros : 0.0) << "% of budget), "
+		<< budgetUsed.maxMillis() << "ms max, " << budgetOverruns << " frames over\n";
+	os << "Chunk load latency: " << chunkLoad.count << " chunks, " << chunkLoad.averageMillis() << "ms avg, "
+		<< chunkLoad.maxMillis() << "ms max from queued to uploaded\n";
+	os << "Visible area complete: " << visibleLoad.count << " times, " << visibleLoad.averageMillis() << "ms avg, "
+		<< visibleLoad.maxMillis() << "ms max after something in view went missing\n";
+	noiseTiles.printStats(os);
+	meshCache.printStats(os);
+	light.printStats(os);
+	if (journal) journal->printStats(os);
+	if (remote) remote->printStats(os);
+	ChunkPool::getInstance().printStats(os);
+	Uploader::getInstance().printStats(os);
+}
+
+MemoryReport World::memoryReport() const {
+	MemoryReport report;
+	for (const auto& entry : chunks) entry.second->reportMemory(report);
+	for (const auto& entry : staged) entry.second->reportMemory(report);
+
+	report.add("queues", "toLoad", toLoad.size());
+	report.add("queues", "toLoadAdded", toLoadAdded.size());
+	report.add("queues", "urgentLoads", urgentLoads.size());
+	report.add("queues", "progress", progress.size());
+	report.add("queues", "promotions", promotions.size());
+	report.add("queues", "approxBytes", toLoad.capacity() * sizeof(ChunkTask) + (toLoadAdded.size() + urgentLoads.size()) * sizeof(ivec3)
+		+ progress.size() * sizeof(decltype(progress)::value_type));
 
-	// for caching to reduce number of map .at calls, stores the last visited chunk
-	static Chunk* lastChunk = nullptr;
-	static ivec2 lastChunkCoords;
+	// the maps' own nodes, the chunks are counted above
+	report.add("chunks", "objectBytes", (chunks.size() + staged.size()) * (sizeof(Chunk) + sizeof(ChunkMap::value_type)));
 
-	ivec2 chunkWorldCoords = {
+	noiseTiles.reportMemory(report);
+	if (journal) journal->reportMemory(report);
+	ChunkPool::getInstance().reportMemory(report);
+	Uploader::getInstance().reportMemory(report);
+	return report;
+}
+
+std::pair<ivec3, ivec3> World::findChunk(ivec3 worldPosition) const {
+	// should be the only out of bounds check (world is theoretically infinite along x and z)
+	if (worldPosition.y < 0 || worldPosition.y >= WORLD_HEIGHT) throw std::out_of_range("Invalid y value");
+
+	ivec3 chunkWorldCoords = {
 		floor((float)worldPosition.x / CHUNK_MAX_X),
+		worldPosition.y / CHUNK_MAX_Y,
 		floor((float)worldPosition.z / CHUNK_MAX_Z)
 	};
 
 	ivec3 inChunkCoords = {
 		(worldPosition.x % CHUNK_MAX_X + CHUNK_MAX_X) % CHUNK_MAX_X,
-		worldPosition.y,
+		worldPosition.y % CHUNK_MAX_Y,
 		(worldPosition.z % CHUNK_MAX_Z + CHUNK_MAX_Z) % CHUNK_MAX_Z
 	};
 
-	if (lastChunk == nullptr || lastChunkCoords != chunkWorldCoords) {
-		lastChunk = chunks.at(chunkWorldCoords).get();
-		lastChunkCoords = chunkWorldCoords;
-	}
-
 	return { chunkWorldCoords, inChunkCoords };
 }
 
 Block::BlockDef World::getBlockDef(ivec3 worldPosition) const {
+	// above and below the world, and sections not loaded yet, are air
+	if (worldPosition.y < 0 || worldPosition.y >= WORLD_HEIGHT) return Block::BlockRegistry::getInstance().getDef(0);
+
 	const auto & [chunkCoords, inChunkCoords] = findChunk(worldPosition);
+	auto found = chunks.find(chunkCoords);
+	if (found == chunks.end()) return Block::BlockRegistry::getInstance().getDef(0);
 
-	return chunks.at(chunkCoords)->getBlockDef(inChunkCoords);
+	return found->second->getBlockDef(inChunkCoords);
 }
 
 bool World::removeBlockAt(ivec3 worldPosition) {
+	if (remote) {
+		remote->edit(worldPosition, 0);
+		return true;
+	}
+
+	if (worldPosition.y < 0 || worldPosition.y >= WORLD_HEIGHT) return false;
+
 	const auto& [chunkCoords, inChunkCoords] = findChunk(worldPosition);
+	auto found = chunks.find(chunkCoords);
+	if (found == chunks.end() || found->second->isCold()) return false;
+	Chunk& chunk = *found->second;
+
+	Block::BlockType oldType = chunk.getBlock(inChunkCoords);
+	if (!chunk.removeBlock(inChunkCoords)) return false;
+	if (journal) journal->record(chunkCoords, inChunkCoords, 0);
 
-	return chunks.at(chunkCoords)->removeBlock(inChunkCoords);
+	light.blockChanged(worldPosition, oldType);
+	remeshDirty();
+	return true;
 }
 
 Block::BlockType World::placeBlockAt(ivec3 worldPosition, Block::BlockType type) {
+	if (remote) {
+		remote->edit(worldPosition, type);
+		return type;
+	}
+
+	if (worldPosition.y < 0 || worldPosition.y >= WORLD_HEIGHT) return 0;
+
 	const auto& [chunkCoords, inChunkCoords] = findChunk(worldPosition);
+	auto found = chunks.find(chunkCoords);
+	if (found == chunks.end() || found->second->isCold()) return 0;
+	Chunk& chunk = *found->second;
 
-	return chunks.at(chunkCoords)->placeBlock(inChunkCoords, type);
+	Block::BlockType oldType = chunk.getBlock(inChunkCoords);
+	Block::BlockType placed = chunk.placeBlock(inChunkCoords, type);
+	if (journal && placed != 0) journal->record(chunkCoords, inChunkCoords, placed);
+
+	light.blockChanged(worldPosition, oldType);
+	remeshDirty();
+	return placed;
+}
+
+Chunk::Neighbours World::getNeighbours(ivec3 coords) const {
+	Chunk::Neighbours neighbours{};
+	for (int face = 0; face < 6; face++) {
+		const int* offset = Mesher::FACE_OFFSETS[face];
+		auto found = chunks.find(coords + ivec3(offset[0], offset[1], offset[2]));
+		if (found != chunks.end()) neighbours[face] = found->second.get();
+	}
+	return neighbours;
+}
+
+void World::queueMesh(ivec3 coords) {
+	// cold chunks are meshed once thawed
+	auto found = chunks.find(coords);
+	if (found == chunks.end() || found->second->isCold()) return;
+
+	auto entry = progress.find(coords);
+	if (entry == progress.end())
+		progress.emplace(coords, Progress{ MESH, false, false, std::chrono::steady_clock::now() });
+	else if (entry->second.running)
+		entry->second.remesh = entry->second.stage == MESH;
+	else if (entry->second.stage > MESH)
+		entry->second = { MESH, false, false, std::chrono::steady_clock::now() };
+}
+
+void World::remeshDirty() {
+	for (ivec3 coords : light.takeDirty()) {
+		if (progress.find(coords) != progress.end()) {
+			queueMesh(coords);
+			continue;
+		}
+
+		auto found = chunks.find(coords);
+		if (found == chunks.end() || found->second->isCold()) continue;
+		found->second->updateMesh(getNeighbours(coords));
+	}
 }
\ No newline at end of file
@@ -3,8 +3,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <exception>
-#include <queue>
+#include <functional>
+#include <limits>
+#include <optional>
 #include <random>
 #include <unordered_map>
 #include <unordered_set>
@@ -12,54 +17,335 @@
 #include <vector>
 
 #include "chunk.h"
+#include "collision.h"
+#include "frustum.h"
+#include "journal.h"
+#include "light.h"
+#include "memory.h"
+#include "meshcache.h"
+#include "profiler.h"
+#include "protocol.h"
 #include "shader.h"
 #include "vecn_hash.hpp"
+#include "workers.h"
 
-using glm::ivec2;
-using glm::vec2;
 using glm::ivec3;
 using glm::vec3;
 
-using std::priority_queue;
-
 static constexpr int RENDER_DISTANCE = 16;
 
+// sections loaded above and below the player's, the loaded box is RENDER_DISTANCE wide and 2 * VERTICAL_RADIUS + 1 tall
+static constexpr int VERTICAL_RADIUS = 2;
+
+// noise tiles kept for the loaded square, a tile is shared by every section of its columns
+static constexpr int NOISE_TILES = Noise::TileCache::tilesFor(RENDER_DISTANCE + 1);
+
+// time World::update may spend on chunk work each frame
+static constexpr int CHUNK_BUDGET_MICROS = 4000;
+
+// chunks further than this from the player along x or z, or COLD_VERTICAL_DISTANCE along y, are frozen into the cold tier
+// they are thawed once back within the loaded box, the gap stops chunks on its edge from flip flopping
+static constexpr int COLD_DISTANCE = RENDER_DISTANCE / 2 + 2;
+static constexpr int COLD_VERTICAL_DISTANCE = VERTICAL_RADIUS + 1;
+
+// storages and buffers the chunk pool keeps, enough for the strips a diagonal step freezes
+static constexpr size_t CHUNK_POOL_SLOTS = 2 * (2 * COLD_DISTANCE + 1) * (2 * VERTICAL_RADIUS + 1);
+
+// chunks this far from spawn are ready before the first frame, the rest stream in
+static constexpr int SPAWN_RADIUS = 1;
+
+// the section the player starts in, the surface lies around HEIGHT_BASELINE
+static const ivec3 SPAWN_CHUNK(0, HEIGHT_BASELINE / CHUNK_MAX_Y, 0);
+
+// how far ahead of the player's velocity chunks are prioritised
+static constexpr float LOOKAHEAD_SECONDS = 1.5f;
+
+// the load queue is rescored once the view has drifted this far since the last time
+static constexpr float RESCORE_DISTANCE = 4.0f; // blocks, of the lookahead point
+static constexpr float RESCORE_ANGLE = 5.0f; // degrees
+
+class ChunkClient;
+
+// where the player and camera are, which decides what loads first
+struct Viewer {
+	vec3 position{ 0.0f };
+	vec3 front{ 0.0f, 0.0f, -1.0f };
+	vec3 velocity{ 0.0f }; // blocks per second
+	Frustum frustum;
+};
+
 class World
 {
 private:
 	uint32_t seed;
-	unordered_map<ivec2, std::unique_ptr<Chunk>, vec2Hash> chunks;
+	ChunkMap chunks;
+
+	// set when a ChunkServer generates and edits the chunks, this world only lights, meshes and draws them
+	ChunkClient* remote = nullptr;
+
+	// sky and block light, kept up to date incrementally as chunks load and blocks change
+	Light::Engine light{ chunks };
+
+	// heightmap offsets shared between neighbouring chunks
+	Noise::TileCache noiseTiles;
 
-	// used in figuring out which chunk to load first
+	// meshes of chunks seen before, in saves/<seed>/meshes
+	MeshCache meshCache;
+
+	// the player's edits, put back on every chunk as it is generated
+	// remote worlds and replays don't keep one, the server keeps its own
+	std::optional<EditJournal> journal;
+
+	// when set, chunks are carved from 3D density instead of the heightmap
+	std::optional<Density::Plan> densityTerrain;
+
+	// used in figuring out which chunk to load first, lower priority loads sooner
 	struct ChunkTask {
-		ivec2 coords;
-		int distance;
+		ivec3 coords;
+		float priority;
 	};
 
 	struct ChunkTaskCompare {
 		bool operator()(const ChunkTask& a, const ChunkTask& b) const {
-			return a.distance > b.distance;
+			return a.priority > b.priority;
 		}
 	};
 
-	std::priority_queue<ChunkTask, std::vector<ChunkTask>, ChunkTaskCompare> toLoad;
-	std::unordered_set<ivec2, vec2Hash> toLoadAdded;
+	// a heap on ChunkTaskCompare, rescored whenever the viewer has moved or turned enough
+	// cancelled tasks stay in toLoad but leave toLoadAdded, they are skipped when they reach the top
+	// remote worlds leave toLoad empty, toLoadAdded holds the chunks still expected from the server
+	vector<ChunkTask> toLoad;
+	std::unordered_set<ivec3, vec3Hash> toLoadAdded;
+
+	Viewer viewer;
+	Viewer scoredViewer; // the viewer toLoad was last scored for
+
+	// how long the visible part of the view took to finish loading each time something in it was missing
+	LatencyStats visibleLoad;
+	std::optional<std::chrono::steady_clock::time_point> visibleIncompleteSince;
+
+	// main thread time update spent each frame and the budgets it was given, updateUntil's unbudgeted passes left out
+	LatencyStats budgetUsed;
+	int64_t budgetGivenMicros = 0;
+	uint64_t budgetOverruns = 0;
+
+	// queued to first upload, for chunks new to the world
+	LatencyStats chunkLoad;
+	std::unordered_map<ivec3, std::chrono::steady_clock::time_point, vec3Hash> loadStarted;
+
+	// filled by cull, reused so culling doesn't allocate
+	vector<const Chunk*> drawList;
+
+	// the chunk loadChunks last centred the loaded box on
+	std::optional<ivec3> loadCenter;
+
+	// generated chunks wait here until they are lit, kept out of chunks so no light spreads into them first
+	ChunkMap staged;
+
+	// the stages a chunk goes through to get on screen, in order
+	// generating and meshing run on the workers, the rest on the main thread within the frame budget
+	enum Stage {
+		GENERATE,
+		DECORATE, // once the chunks within DECORATE_REACH are generated
+		LIGHT, // once the chunks within DECORATE_REACH are decorated, so nothing writes into it after, and the section above is lit
+		MESH, // once the six neighbours are lit, so the light along its borders is final
+		UPLOAD,
+
+		STAGE_COUNT,
+	};
+
+	static constexpr const char* STAGE_NAMES[STAGE_COUNT] = { "generate", "decorate", "light", "mesh", "upload" };
+
+	// how far decorations may reach into neighbouring chunks, nothing decorates yet
+	static constexpr int DECORATE_REACH = 0;
+
+	struct Progress {
+		Stage stage;
+		bool running = false; // on a worker
+		bool remesh = false; // the mesh on the worker is stale already
+		std::chrono::steady_clock::time_point since; // when it reached the stage
+	};
+
+	// every chunk on the way to the screen, from when its generation starts to its upload
+	// thawed chunks and done chunks a neighbour's light reached come back in at MESH
+	std::unordered_map<ivec3, Progress, vec3Hash> progress;
+
+	// reaching a stage to leaving it, waiting on neighbours included
+	LatencyStats stageLatency[STAGE_COUNT];
+
+	// queued chunks that a chunk further along is waiting on, generated ahead of toLoad
+	std::deque<ivec3> urgentLoads;
+
+	// chunks each stage could run this update, best priority first, reused so update doesn't allocate
+	vector<std::pair<float, ivec3>> ready[STAGE_COUNT];
+
+	// chunks that aren't cold, they stay near the player so updateResidency never walks everything ever loaded
+	std::unordered_set<ivec3, vec3Hash> hot;
+
+	// thawed chunks waiting to be back on screen, and when they were thawed
+	std::unordered_map<ivec3, std::chrono::steady_clock::time_point, vec3Hash> promotions;
+
+	struct ResidencyStats {
+		uint64_t freezes = 0;
+		uint64_t thaws = 0;
+		uint64_t promotionsCompleted = 0;
+		int64_t promotionMicros = 0; // thaw to upload, summed
+		int64_t maxPromotionMicros = 0;
+	} residency;
+
+	// running average of how long the main thread stages take, in microseconds
+	// remote worlds decode chunks from the server on the main thread as their generate stage
+	float stageCost[STAGE_COUNT] = { 300.0f, 0.0f, 2000.0f, 0.0f, 300.0f };
+
+	bool hasRemoteUpdates() const;
+
+	// updates without a budget until done returns true, waiting on the workers when nothing else can move
+	void updateUntil(const std::function<bool()>& done);
+
+	// gets every queued chunk within SPAWN_RADIUS of center on screen
+	void loadSpawn(ivec3 center);
+
+	// pops cancelled generation tasks off the top of toLoad
+	void skipCancelled();
+
+	// how far a chunk is, STAGE_COUNT once it is done or if it isn't coming at all
+	Stage stageOf(ivec3 coords) const;
+
+	bool isReady(ivec3 coords, Stage stage);
+
+	// whether every chunk within reach is past stage, diagonals only counted when asked
+	// queued ones a wanted chunk waits on are hurried along
+	bool neighboursPast(ivec3 coords, Stage stage, int reach, bool diagonals);
+
+	// whether one chunk is past stage, hurrying it along when it's queued and hurry is set
+	bool isPast(ivec3 coords, Stage stage, bool hurry);
+
+	// moves a chunk into its next stage, recording how long it spent in this one
+	void completeStage(ivec3 coords, Progress& entry);
+
+	// slices its heights here and hands the rest to a worker
+	void startGenerating(ivec3 coords);
+
+	// submits a mesh built from snapshots of it and its neighbours
+	void startMeshing(ivec3 coords);
+
+	// takes a mesh from a worker, meshing again if the chunk changed since its snapshot
+	void finishMesh(ivec3 coords, vector<Vertex>&& vertices, uint64_t builtFrom);
+
+	// lights a staged chunk into chunks, sending the neighbours its light reached back to MESH
+	void lightChunk(ivec3 coords);
+
+	void uploadChunk(ivec3 coords);
+
+	// a generated or received chunk enters the world staged, at DECORATE
+	void addChunk(ivec3 coords, std::unique_ptr<Chunk> chunk);
+
+	// takes the next chunk from the server, the remote world's generate stage
+	// a chunk it already has was dropped by the server when it left the box, and missed the edits since
+	void receiveChunk();
+
+	// applies the deltas at the front of the remote queue, up to the next chunk
+	void applyRemoteDeltas();
+
+	void applyDelta(const Protocol::Delta& delta);
+
+	// the blocks of received that differ from the loaded chunk at coords, as a delta
+	Protocol::Delta diffBlocks(ivec3 coords, const Chunk& received);
+
+	// visible chunks come first, then by distance from where the player is heading
+	float chunkPriority(ivec3 coords) const;
+
+	// on screen or right around the player, these wait behind nothing off screen
+	bool isWanted(ivec3 coords) const;
+
+	void rescoreLoadQueue();
+
+	// times how long visible chunks stay missing
+	void trackVisibleLoad();
+
+	inline bool isVisible(ivec3 coords) const {
+		vec3 min = vec3(coords) * vec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z);
+		return viewer.frustum.intersects(min, min + vec3(CHUNK_MAX_X, CHUNK_MAX_Y, CHUNK_MAX_Z));
+	}
+
+	// loaded neighbours of a chunk, for meshing its borders
+	Chunk::Neighbours getNeighbours(ivec3 coords) const;
+
+	// sends a chunk back to MESH, chunks not there yet mesh when they get there anyway
+	void queueMesh(ivec3 coords);
+
+	// remeshes every done chunk the light engine changed right away, so edits show up the same frame
+	// chunks still in the pipeline go back to MESH instead
+	void remeshDirty();
+
+	// freezes chunks past COLD_DISTANCE and thaws cold ones the player came back to
+	void updateResidency(ivec3 playerChunk);
+
+	// declared last so it is destroyed first, its jobs hold pointers into the members above
+	WorkerPool workers;
 
 public:
-	World(uint32_t seed = UINT32_MAX);
+	// blockingStartup loads the whole view distance up front instead of only the spawn ring
+	// persistEdits saves edits and puts back the ones saved for this seed before
+	World(uint32_t seed = UINT32_MAX, bool useDensityTerrain = false, bool blockingStartup = false, bool persistEdits = true);
+
+	// chunks come from the server behind remote and edits go to it, see ChunkServer
+	explicit World(ChunkClient& remote);
 
-	void loadChunks(ivec2 playerChunk);
+	// rolling hills matching the heightmap, plus overhangs and caves
+	static Density::Plan buildDensityTerrain(uint32_t seed);
 
-	void update(int numChunks = 1);
+	// queues the box of chunks around the player, only doing work when playerChunk changed
+	// then only the strip that came into view is queued and queued chunks that left it are cancelled
+	void loadChunks(ivec3 playerChunk);
 
-	const void draw(Shader & shader, ivec2 playerChunk);
+	// call every frame before update, the load queue is rescored when the view changed enough
+	void setViewer(const Viewer& newViewer);
+
+	// does as much chunk work as the estimated costs say fits in budgetMicros,
+	// leaving the rest queued for the next call
+	// returns the microseconds actually used
+	int update(int budgetMicros = CHUNK_BUDGET_MICROS);
+
+	inline bool hasPendingWork() const {
+		return !toLoadAdded.empty() || !progress.empty() || hasRemoteUpdates();
+	}
+
+	// chunks near enough to playerChunk and inside the viewer's frustum, valid until the next call
+	const vector<const Chunk*>& cull(ivec3 playerChunk);
+
+	const void draw(Shader & shader, ivec3 playerChunk);
+
+	inline const LatencyStats& getChunkLoadLatency() const {
+		return chunkLoad;
+	}
+
+	inline const LatencyStats& getVisibleLoadLatency() const {
+		return visibleLoad;
+	}
+
+	// chunk counts, pipeline and load latencies, then each cache's and the journal's stats
+	void printStats(std::ostream& os) const;
+
+	// what every chunk, queue and cache holds right now
+	MemoryReport memoryReport() const;
 
 	// returns a tuple where the first is chunk coords
 	// econd is in chunk block coords
-	std::pair<ivec2, ivec3> findChunk(ivec3 worldPosition) const;
+	std::pair<ivec3, ivec3> findChunk(ivec3 worldPosition) const;
+
+	// moves a box by up to delta without entering solid blocks, returns how far it moved
+	inline vec3 moveBox(Collision::AABB& box, vec3 delta, glm::bvec3& blocked) const {
+		return Collision::move(chunks, box, delta, blocked);
+	}
+
+	inline void moveBodies(vector<Collision::Body>& bodies, float seconds) const {
+		Collision::moveBodies(chunks, bodies, seconds);
+	}
 
 	Block::BlockDef getBlockDef(ivec3 worldPosition) const;
 
+	// remote worlds only ask the server, the change shows up once its delta comes back
 	bool removeBlockAt(ivec3 worldPosition);
 
 	Block::BlockType placeBlockAt(ivec3 worldPosition, Block::BlockType type);